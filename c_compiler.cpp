@@ -0,0 +1,206 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "c_compiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+#include "files.h"
+#include "hasher.h"
+
+extern char** environ;
+
+namespace {
+
+// Formats a hash as a fixed-width hexadecimal string, for naming files
+std::string hex(std::uint64_t value) {
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx",
+    static_cast<unsigned long long>(value));
+  return text;
+}
+
+// Hashes the string, with its length so that consecutive strings are distinct
+std::uint64_t hash_string(const std::string& text, std::uint64_t seed) {
+  std::size_t size = text.size();
+  return hash_bytes(text.data(), size, hash_bytes(&size, sizeof(size), seed));
+}
+
+// Starts the command, returning its process ID, or -1 if it cannot be started
+pid_t spawn(const std::vector<std::string>& command) {
+  std::vector<char*> argv;
+  for (const std::string& arg : command) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ)) {
+    return -1;
+  }
+  return pid;
+}
+
+}  // namespace
+
+CCompiler::CCompiler(std::string compiler,
+  std::vector<std::string> compile_flags, std::vector<std::string> link_flags,
+  std::size_t jobs):
+  compiler_{std::move(compiler)},
+  compile_flags_{std::move(compile_flags)},
+  link_flags_{std::move(link_flags)},
+  jobs_{std::max<std::size_t>(jobs, 1)}
+{}
+
+bool CCompiler::build(const std::vector<CSources>& code,
+  const std::string& object_dir, const std::string& executable)
+{
+  hits_ = 0;
+  misses_ = 0;
+  linked_ = false;
+  std::error_code error;
+  std::filesystem::create_directories(object_dir, error);
+  std::uint64_t command_hash = hash_command(compile_flags_, hash_seed);
+
+  // Compile the sources whose objects are not cached, each object only once
+  std::vector<std::string> objects;
+  std::vector<std::vector<std::string>> commands;
+  std::vector<std::pair<std::string, std::string>> outputs;
+  std::set<std::string> scheduled;
+  std::string suffix = ".tmp" + std::to_string(getpid());
+  for (const CSources& sources : code) {
+    std::optional<std::string> header_code = read_file(sources.header);
+    if (!header_code) return false;
+    std::uint64_t header_hash = hash_string(*header_code, command_hash);
+    for (const std::string& source : sources.sources) {
+      std::optional<std::string> source_code = read_file(source);
+      if (!source_code) return false;
+      std::string object = (std::filesystem::path{object_dir} /
+        (hex(hash_string(*source_code, header_hash)) + ".o")).string();
+      objects.push_back(object);
+      if (std::filesystem::exists(object, error)) {
+        ++hits_;
+      } else if (scheduled.insert(object).second) {
+        ++misses_;
+        std::vector<std::string> command{compiler_};
+        command.insert(command.end(), compile_flags_.begin(),
+          compile_flags_.end());
+        command.insert(command.end(), {"-c", source, "-o", object + suffix});
+        commands.push_back(std::move(command));
+        outputs.emplace_back(object + suffix, object);
+      }
+    }
+  }
+
+  // Objects only appear in the cache once completely written
+  std::vector<bool> compiled{run(commands)};
+  bool succeeded = true;
+  for (std::size_t i = 0; i < outputs.size(); ++i) {
+    if (compiled[i]) {
+      std::filesystem::rename(outputs[i].first, outputs[i].second, error);
+      succeeded &= !error;
+    } else {
+      std::filesystem::remove(outputs[i].first, error);
+      succeeded = false;
+    }
+  }
+  if (!succeeded) return false;
+
+  /*
+    The executable is linked again only if its objects or the link command
+    changed, as recorded in a file next to the executable
+  */
+  std::uint64_t link_hash = hash_command(link_flags_, hash_seed);
+  for (const std::string& object : objects) {
+    link_hash = hash_string(object, link_hash);
+  }
+  std::string link_key = hex(link_hash);
+  std::string link_record = executable + ".link";
+  if (std::filesystem::exists(executable, error) &&
+    read_file(link_record) == link_key)
+  {
+    return true;
+  }
+  std::vector<std::string> command{compiler_};
+  command.insert(command.end(), objects.begin(), objects.end());
+  command.insert(command.end(), link_flags_.begin(), link_flags_.end());
+  command.insert(command.end(), {"-o", executable});
+  if (!run({command}).front()) return false;
+  linked_ = true;
+  write_file_if_changed(link_record, link_key);
+  return true;
+}
+
+std::vector<bool> CCompiler::run(
+  const std::vector<std::vector<std::string>>& commands)
+{
+  std::vector<bool> succeeded(commands.size(), false);
+  std::map<pid_t, std::size_t> running;
+  std::size_t next = 0;
+  bool failed = false;
+  while (true) {
+    while (!failed && next < commands.size() && running.size() < jobs_) {
+      pid_t pid = spawn(commands[next]);
+      if (pid < 0) {
+        failed = true;
+        break;
+      }
+      running.emplace(pid, next++);
+    }
+    if (running.empty()) break;
+
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    auto command = running.find(pid);
+    if (command == running.end()) continue;
+    succeeded[command->second] = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    failed |= !succeeded[command->second];
+    running.erase(command);
+  }
+  return succeeded;
+}
+
+std::uint64_t CCompiler::hash_command(
+  const std::vector<std::string>& flags, std::uint64_t seed) const
+{
+  seed = hash_string(compiler_, seed);
+  for (const std::string& flag : flags) {
+    seed = hash_string(flag, seed);
+  }
+  return seed;
+}
+
+std::vector<std::string> split_flags(const std::string& flags) {
+  std::vector<std::string> split;
+  std::istringstream stream{flags};
+  std::string flag;
+  while (stream >> flag) {
+    split.push_back(flag);
+  }
+  return split;
+}
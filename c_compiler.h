@@ -0,0 +1,91 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Drives the system C compiler to turn the C code written by the translator
+  into an executable. Each source file is compiled by its own compiler process,
+  several of them running at once, and the objects are then linked.
+
+  Objects are cached in a directory, keyed by a hash of everything that goes
+  into them: the compiler command, the flags, the source file, and the shared
+  header it includes. Source files whose code did not change are therefore not
+  compiled again, and the executable is not linked again if none of its objects
+  changed. System headers are not part of the key, so the cache must be cleared
+  when they change.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// C source files that include the same header
+struct CSources {
+  std::string header;
+  std::vector<std::string> sources;
+};
+
+// Compiles and links C code by running the C compiler
+class CCompiler {
+public:
+  /*
+    Uses the given compiler command, with the flags for compiling and linking.
+    At most jobs compilers are run at once.
+  */
+  CCompiler(std::string compiler, std::vector<std::string> compile_flags,
+    std::vector<std::string> link_flags, std::size_t jobs);
+
+  /*
+    Compiles the source files, each of which includes the header it is listed
+    with, into objects in the object directory, and links them into the
+    executable. Returns false if a compiler or the linker failed, or could not
+    be run, once the compilers that were already running have finished. The
+    compiler reports its errors to standard error.
+  */
+  bool build(const std::vector<CSources>& code, const std::string& object_dir,
+    const std::string& executable);
+
+  // Number of objects found in the cache, and compiled, by the last build
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+  // Whether the last build linked the executable, rather than reusing it
+  bool linked() const { return linked_; }
+
+private:
+  /*
+    Runs the commands, at most jobs_ at once, returning whether each of them
+    succeeded. Once one fails, the commands not yet started are not run.
+  */
+  std::vector<bool> run(const std::vector<std::vector<std::string>>& commands);
+
+  // Hashes the compiler and the flags, continuing from seed
+  std::uint64_t hash_command(
+    const std::vector<std::string>& flags, std::uint64_t seed) const;
+
+  std::string compiler_;
+  std::vector<std::string> compile_flags_;
+  std::vector<std::string> link_flags_;
+  std::size_t jobs_;
+  std::size_t hits_ = 0;
+  std::size_t misses_ = 0;
+  bool linked_ = false;
+};
+
+// Splits a string of flags at whitespace
+std::vector<std::string> split_flags(const std::string& flags);
@@ -0,0 +1,474 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "constant_folding.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+RegisterPass<ConstantFoldingPass> register_constant_folding{"fold-constants"};
+
+// Range of the target's int
+constexpr std::int64_t int_min = std::numeric_limits<std::int32_t>::min();
+constexpr std::int64_t int_max = std::numeric_limits<std::int32_t>::max();
+
+// The operator that a compound assignment applies, such as + for +=
+std::optional<OperatorType> compound_operator(OperatorType operator_type) {
+  switch (operator_type) {
+    case OperatorType::divide_assign:
+      return OperatorType::divide;
+    case OperatorType::minus_assign:
+      return OperatorType::minus;
+    case OperatorType::modulo_assign:
+      return OperatorType::modulo;
+    case OperatorType::multiply_assign:
+      return OperatorType::multiply;
+    case OperatorType::plus_assign:
+      return OperatorType::plus;
+    default:
+      return std::nullopt;
+  }
+}
+
+// The expression as an integer, or nullptr if it is not an integer
+const IntegerExpression* as_integer(
+  const std::shared_ptr<Expression>& expression)
+{
+  return dynamic_cast<const IntegerExpression*>(expression.get());
+}
+
+std::shared_ptr<Expression> make_integer(
+  std::int64_t value, std::shared_ptr<Class> cls)
+{
+  auto integer_expression = std::make_shared<IntegerExpression>();
+  integer_expression->set_value(value);
+  integer_expression->set_cls(std::move(cls));
+  return integer_expression;
+}
+
+// What the folder knows about an expression once it is simplified
+struct Facts {
+  // Whether the expression evaluates to an int
+  bool is_int;
+  // Whether evaluating the expression calls a function or assigns an object
+  bool has_side_effects;
+};
+
+/*
+  The facts of an expression that is not an operator expression, which do not
+  depend on its sub-expressions. The facts of operator expressions are
+  gathered from their operands as they are simplified (see Folder::fold).
+*/
+Facts own_facts(const Expression& expression) {
+  if (dynamic_cast<const IntegerExpression*>(&expression)) {
+    return Facts{true, false};
+  }
+  if (auto object_expression =
+    dynamic_cast<const ObjectExpression*>(&expression))
+  {
+    return Facts{object_expression->object()->cls()->name() == "int", false};
+  }
+  if (auto call_expression =
+    dynamic_cast<const CallExpression*>(&expression))
+  {
+    const Function& function = *call_expression->function();
+    return Facts{function.return_type() == ReturnType::value &&
+      function.return_class()->name() == "int", true};
+  }
+  return Facts{false, false};
+}
+
+/*
+  Folds the statements of a function in order, tracking the objects that are
+  known to hold constants. Functions have no control flow yet, so every
+  statement runs after the statements before it.
+*/
+class Folder {
+public:
+  /*
+    Folds the expression of a statement, returning its replacement, or nullptr
+    if the expression was kept (though possibly modified)
+  */
+  std::shared_ptr<Expression> fold(const std::shared_ptr<Expression>& root);
+
+private:
+  void find_assignments(const Expression& root);
+  void record_assignment(const OperatorExpression& assignment);
+  std::shared_ptr<Expression> simplify(ObjectExpression& object_expression);
+  std::shared_ptr<Expression> simplify(
+    OperatorExpression& operator_expression, const Facts& operands);
+
+  // Values of the objects known to hold constants
+  std::unordered_map<const Object*, std::int64_t> constants_;
+  /*
+    Objects assigned by nested assignments in the statement being folded.
+    Their reads in the statement may happen before or after the assignment,
+    so they are not replaced.
+  */
+  std::unordered_set<const Object*> unstable_;
+};
+
+std::shared_ptr<Expression> Folder::fold(
+  const std::shared_ptr<Expression>& root)
+{
+  find_assignments(*root);
+
+  /*
+    Simplify the expressions in post-order without recursion, replacing each
+    simplified expression in its parent. The object assigned by an assignment
+    is not a read, so it is not visited. The facts of each simplified
+    expression are gathered into its parent's frame, so that no expression is
+    walked more than once.
+  */
+  struct Frame {
+    Expression* expression;
+    EntityContainer<Expression>* container;
+    // Index of the next sub-expression to visit
+    std::size_t next;
+    // Whether the first sub-expression evaluates to an int
+    bool first_is_int;
+    /*
+      Whether all of the sub-expressions visited so far evaluate to ints, and
+      whether any of them has side effects
+    */
+    Facts operands;
+  };
+  auto frame = [](Expression* expression) {
+    return Frame{expression,
+      dynamic_cast<EntityContainer<Expression>*>(expression), 0, false,
+      Facts{true, false}};
+  };
+  std::shared_ptr<Expression> replacement;
+  std::vector<Frame> stack{frame(root.get())};
+  while (!stack.empty()) {
+    Frame& top = stack.back();
+    if (top.container && top.next < top.container->entities().size()) {
+      auto operator_expression =
+        dynamic_cast<const OperatorExpression*>(top.expression);
+      if (top.next == 0 && operator_expression &&
+        is_assignment(operator_expression->operator_type()))
+      {
+        top.first_is_int =
+          own_facts(*top.container->entities().front()).is_int;
+        ++top.next;
+        continue;
+      }
+      stack.push_back(frame(top.container->entities()[top.next].get()));
+      continue;
+    }
+
+    std::shared_ptr<Expression> simplified;
+    Facts facts;
+    if (auto operator_expression =
+      dynamic_cast<OperatorExpression*>(top.expression))
+    {
+      simplified = simplify(*operator_expression, top.operands);
+      if (!simplified) {
+        facts = Facts{top.first_is_int, top.operands.has_side_effects ||
+          is_assignment(operator_expression->operator_type())};
+      } else if (as_integer(simplified)) {
+        facts = Facts{true, false};
+      } else {
+        // One operand is left, the others being integers without effects
+        facts = Facts{true, top.operands.has_side_effects};
+      }
+    } else {
+      if (auto object_expression =
+        dynamic_cast<ObjectExpression*>(top.expression))
+      {
+        simplified = simplify(*object_expression);
+      }
+      facts = simplified ? Facts{true, false} : own_facts(*top.expression);
+    }
+    stack.pop_back();
+    if (stack.empty()) {
+      replacement = simplified;
+      break;
+    }
+    Frame& parent = stack.back();
+    if (simplified) parent.container->replace(parent.next, simplified);
+    if (parent.next == 0) parent.first_is_int = facts.is_int;
+    parent.operands.is_int &= facts.is_int;
+    parent.operands.has_side_effects |= facts.has_side_effects;
+    ++parent.next;
+  }
+
+  for (const Object* object : unstable_) {
+    constants_.erase(object);
+  }
+  auto assignment = dynamic_cast<const OperatorExpression*>(root.get());
+  if (!replacement && assignment &&
+    is_assignment(assignment->operator_type()))
+  {
+    record_assignment(*assignment);
+  }
+  return replacement;
+}
+
+// Finds the objects assigned by the nested assignments of the statement
+void Folder::find_assignments(const Expression& root) {
+  unstable_.clear();
+  std::vector<const Expression*> stack{&root};
+  while (!stack.empty()) {
+    const Expression* expression = stack.back();
+    stack.pop_back();
+    auto container =
+      dynamic_cast<const EntityContainer<Expression>*>(expression);
+    if (!container) continue;
+    auto operator_expression =
+      dynamic_cast<const OperatorExpression*>(expression);
+    if (expression != &root && operator_expression &&
+      is_assignment(operator_expression->operator_type()))
+    {
+      auto target = static_cast<const ObjectExpression*>(
+        operator_expression->expression_entities().front().get());
+      unstable_.insert(target->object().get());
+    }
+    for (const auto& sub_expression : container->entities()) {
+      stack.push_back(sub_expression.get());
+    }
+  }
+}
+
+/*
+  Updates the constant held by the object assigned by a statement, which is
+  only known if an integer is assigned
+*/
+void Folder::record_assignment(const OperatorExpression& assignment) {
+  const auto& operands = assignment.expression_entities();
+  auto target = static_cast<const ObjectExpression*>(operands[0].get());
+  const Object* object = target->object().get();
+  const IntegerExpression* value = as_integer(operands[1]);
+  if (value && assignment.operator_type() == OperatorType::assign) {
+    constants_[object] = value->value();
+    return;
+  }
+  auto constant = constants_.find(object);
+  if (constant == constants_.end()) return;
+  std::optional<std::int64_t> result;
+  if (value) {
+    result =
+      evaluate(assignment.operator_type(), constant->second, value->value());
+  }
+  if (result) {
+    constant->second = *result;
+  } else {
+    constants_.erase(constant);
+  }
+}
+
+/*
+  Replaces a read of an object known to hold a constant with the constant,
+  returning nullptr if the object is kept
+*/
+std::shared_ptr<Expression> Folder::simplify(
+  ObjectExpression& object_expression)
+{
+  const std::shared_ptr<Object>& object = object_expression.object();
+  auto constant = constants_.find(object.get());
+  if (constant == constants_.end() || unstable_.count(object.get())) {
+    return nullptr;
+  }
+  return make_integer(constant->second, object->cls());
+}
+
+/*
+  Simplifies the operator expression, whose operands are already simplified,
+  returning its replacement, or nullptr if it was kept. The facts tell whether
+  all of the operands are ints, and whether any of them has side effects.
+*/
+std::shared_ptr<Expression> Folder::simplify(
+  OperatorExpression& operator_expression, const Facts& operands_facts)
+{
+  OperatorType operator_type = operator_expression.operator_type();
+  if (is_assignment(operator_type) || !operands_facts.is_int) return nullptr;
+  std::vector<std::shared_ptr<Expression>> operands{
+    operator_expression.expression_entities()};
+  bool changed = false;
+
+  // Operators apply from left to right, so leading integers are evaluated
+  while (operands.size() >= 2) {
+    const IntegerExpression* left = as_integer(operands[0]);
+    const IntegerExpression* right = as_integer(operands[1]);
+    if (!left || !right) break;
+    std::optional<std::int64_t> value =
+      evaluate(operator_type, left->value(), right->value());
+    if (!value) break;
+    operands[0] = make_integer(*value, left->cls());
+    operands.erase(operands.begin() + 1);
+    changed = true;
+  }
+
+  /*
+    Adjacent integers elsewhere in + and * chains are combined into one, as
+    are adjacent subtracted integers of - chains, so that a+1+2+b becomes
+    a+3+b. This only skips intermediate results, so if the original chain does
+    not overflow, then neither does the combined one. Integers are not moved
+    past other operands, since a+5+b+5 computed as a+b+10 has intermediate
+    results of its own, which may overflow where the original did not.
+  */
+  if (operator_type == OperatorType::plus ||
+    operator_type == OperatorType::multiply ||
+    operator_type == OperatorType::minus)
+  {
+    OperatorType combine = operator_type == OperatorType::minus ?
+      OperatorType::plus : operator_type;
+    std::size_t first = operator_type == OperatorType::minus ? 1 : 0;
+    std::vector<std::shared_ptr<Expression>> kept{
+      operands.begin(), operands.begin() + first};
+    for (std::size_t i = first; i < operands.size(); ++i) {
+      const IntegerExpression* integer = as_integer(operands[i]);
+      const IntegerExpression* previous =
+        kept.size() > first ? as_integer(kept.back()) : nullptr;
+      std::optional<std::int64_t> combined;
+      if (integer && previous) {
+        combined = evaluate(combine, previous->value(), integer->value());
+      }
+      if (combined) {
+        kept.back() = make_integer(*combined, integer->cls());
+        changed = true;
+      } else {
+        kept.push_back(operands[i]);
+      }
+    }
+    operands = std::move(kept);
+  }
+
+  // Operands that do not change the result are dropped: x+0, x-0, x*1, x/1
+  std::optional<std::int64_t> identity;
+  std::size_t first_droppable = 1;
+  switch (operator_type) {
+    case OperatorType::plus:
+      identity = 0;
+      first_droppable = 0;
+      break;
+    case OperatorType::minus:
+      identity = 0;
+      break;
+    case OperatorType::multiply:
+      identity = 1;
+      first_droppable = 0;
+      break;
+    case OperatorType::divide:
+      identity = 1;
+      break;
+    default:
+      break;
+  }
+  for (std::size_t i = first_droppable; identity && i < operands.size(); ) {
+    const IntegerExpression* integer = as_integer(operands[i]);
+    if (operands.size() > 1 && integer && integer->value() == *identity) {
+      operands.erase(operands.begin() + i);
+      changed = true;
+    } else {
+      ++i;
+    }
+  }
+
+  /*
+    x*0 is 0, unless evaluating x has effects that must be kept. The dropped
+    operands are integers, so the remaining ones have the effects.
+  */
+  if (operator_type == OperatorType::multiply &&
+    !operands_facts.has_side_effects)
+  {
+    for (const auto& operand : operands) {
+      const IntegerExpression* integer = as_integer(operand);
+      if (integer && integer->value() == 0) {
+        return make_integer(0, integer->cls());
+      }
+    }
+  }
+
+  if (operands.size() == 1) return operands.front();
+  if (changed) {
+    operator_expression.clear();
+    for (const auto& operand : operands) {
+      operator_expression.add(operand);
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+// Division truncates toward zero in both C and C++
+std::optional<std::int64_t> evaluate(
+  OperatorType operator_type, std::int64_t left, std::int64_t right)
+{
+  if (std::optional<OperatorType> applied = compound_operator(operator_type)) {
+    operator_type = *applied;
+  }
+  std::int64_t result;
+  switch (operator_type) {
+    case OperatorType::plus:
+      result = left + right;
+      break;
+    case OperatorType::minus:
+      result = left - right;
+      break;
+    case OperatorType::multiply:
+      result = left * right;
+      break;
+    case OperatorType::divide:
+    case OperatorType::modulo:
+      if (right == 0 || (left == int_min && right == -1)) return std::nullopt;
+      result = operator_type == OperatorType::divide ?
+        left / right : left % right;
+      break;
+    case OperatorType::equal:
+      return left == right;
+    case OperatorType::not_equal:
+      return left != right;
+    case OperatorType::less:
+      return left < right;
+    case OperatorType::less_equal:
+      return left <= right;
+    case OperatorType::greater:
+      return left > right;
+    case OperatorType::greater_equal:
+      return left >= right;
+    default:
+      return std::nullopt;
+  }
+  if (result < int_min || result > int_max) return std::nullopt;
+  return result;
+}
+
+void fold_constants(Function& function) {
+  Folder folder;
+  const auto& statements = function.statement_entities();
+  for (std::size_t i = 0; i < statements.size(); ++i) {
+    if (auto return_statement =
+      std::dynamic_pointer_cast<ReturnStatement>(statements[i]))
+    {
+      if (!return_statement->expression()) continue;
+      if (auto folded = folder.fold(return_statement->expression())) {
+        return_statement->set_expression(folded);
+      }
+    } else if (auto expression =
+      std::dynamic_pointer_cast<Expression>(statements[i]))
+    {
+      if (auto folded = folder.fold(expression)) function.replace(i, folded);
+    }
+  }
+}
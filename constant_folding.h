@@ -0,0 +1,70 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Constant folding replaces expressions on ints whose value is known at compile
+  time with that value. Within each function:
+    - Operator expressions whose operands are integers are evaluated, as are
+      the leading integer operands of longer chains, so that 2*3+a becomes
+      6+a. Adjacent integer operands of + and * chains are combined, and
+      adjacent subtracted integers of - chains are summed, so that a+1+2
+      becomes a+3. Integers are never moved past other operands, which could
+      make an intermediate result overflow.
+    - Constants are propagated through objects: once an object is assigned an
+      integer, later reads of the object are replaced by the integer, until the
+      object is assigned again.
+    - Algebraic identities are simplified: x+0, x-0, x*1 and x/1 become x, and
+      x*0 becomes 0 if x has no side effects.
+
+  Operations are evaluated as the C code would compute them on the target,
+  whose int is 32 bits wide, since int is translated to the C int. Operations
+  with undefined behavior in C, such as overflowing an int or dividing by zero,
+  are left for the C code to compute, so folding never changes the behavior of
+  a program whose behavior is defined.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include "graph.h"
+#include "pass_manager.h"
+
+/*
+  Computes the operator on two ints as the C code would on the target, or
+  returns nothing if the result is undefined in C. Compound assignments compute
+  the operator they apply, such as + for +=, and plain assignments return
+  nothing.
+*/
+std::optional<std::int64_t> evaluate(
+  OperatorType operator_type, std::int64_t left, std::int64_t right);
+
+// Folds the constant expressions of the function
+void fold_constants(Function& function);
+
+// Runs fold_constants on each function, registered as "fold-constants"
+class ConstantFoldingPass : public Pass {
+public:
+  std::string name() const override { return "fold-constants"; }
+  PassGranularity granularity() const override {
+    return PassGranularity::function;
+  }
+  void run_function(std::shared_ptr<Function> function) override {
+    fold_constants(*function);
+  }
+};
@@ -0,0 +1,65 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "diagnostics.h"
+#include <algorithm>
+#include <tuple>
+
+void Diagnostics::report(Diagnostic diagnostic) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (diagnostic.severity == Severity::error) ++error_count_;
+  entries_.push_back(std::move(diagnostic));
+}
+
+bool Diagnostics::has_errors() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return error_count_ > 0;
+}
+
+std::vector<Diagnostic> Diagnostics::entries() const {
+  std::vector<Diagnostic> entries;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    entries = entries_;
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+    [](const Diagnostic& a, const Diagnostic& b) {
+      return std::tie(a.file_name, a.line_number, a.column_number, a.message)
+        < std::tie(b.file_name, b.line_number, b.column_number, b.message);
+    });
+  return entries;
+}
+
+std::ostream& operator<<(std::ostream& os, const Severity& severity) {
+  switch (severity) {
+    case Severity::error:
+      os << "error";
+      break;
+    case Severity::warning:
+      os << "warning";
+      break;
+    default:
+      os << "unknown";
+      break;
+  }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const Diagnostic& diagnostic) {
+  if (!diagnostic.file_name.empty()) os << diagnostic.file_name << ":";
+  return os << diagnostic.line_number << ":" << diagnostic.column_number
+    << ": " << diagnostic.severity << ": " << diagnostic.message;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Diagnostics are the errors and warnings found while compiling. Instead of
+  stopping at the first error, compiler phases report each problem to a
+  diagnostics collection and carry on, so that a single run lists every
+  problem in the program. Whether to continue to later phases is up to the
+  caller, which also makes the compiler usable as a library.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How serious a diagnostic is
+enum class Severity {
+  // The program is invalid, and cannot be translated
+  error,
+  // The program is valid, but likely contains a mistake
+  warning,
+};
+
+// A single problem found in a program
+struct Diagnostic {
+  Severity severity;
+  // Source file where the problem was found, or empty if not known
+  std::string file_name;
+  // Line of the source file where the problem was found
+  int line_number;
+  // Column of the source file where the problem was found
+  int column_number;
+  std::string message;
+};
+
+/*
+  Collects diagnostics reported by the compiler phases. Diagnostics may be
+  reported from multiple threads at once.
+*/
+class Diagnostics {
+public:
+  // Adds a diagnostic to the collection
+  void report(Diagnostic diagnostic);
+
+  // Whether any diagnostic with Severity::error has been reported
+  bool has_errors() const;
+
+  /*
+    All diagnostics reported so far, ordered by file, line, and column, so the
+    order does not depend on which thread reported them first.
+  */
+  std::vector<Diagnostic> entries() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<Diagnostic> entries_;
+  std::size_t error_count_ = 0;
+};
+
+// Prints a diagnostic in the form "file:line:column: severity: message"
+std::ostream& operator<<(std::ostream& os, const Severity& severity);
+std::ostream& operator<<(std::ostream& os, const Diagnostic& diagnostic);
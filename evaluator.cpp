@@ -0,0 +1,422 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "evaluator.h"
+#include "constant_folding.h"
+
+namespace {
+
+RegisterPass<PrecomputePass> register_precompute{"precompute"};
+
+// Whether the class is the built in int
+bool is_int(const std::shared_ptr<Class>& cls) {
+  return cls && cls->name() == "int";
+}
+
+// Whether the function takes and returns ints only
+bool has_int_signature(const Function& function) {
+  if (function.return_type() != ReturnType::value ||
+    !is_int(function.return_class()))
+  {
+    return false;
+  }
+  for (const auto& object : function.object_entities()) {
+    if (!is_int(object->cls())) return false;
+  }
+  return true;
+}
+
+// Kind of operation of an instruction
+enum class Operation {
+  // Pushes an integer
+  integer,
+  // Pushes the value of an object
+  load,
+  // Pops the operands, and pushes the result of an operator applied to them
+  apply,
+  // Pops a value, assigns it to an object, and pushes the assigned value
+  assign,
+  // Pops the arguments, and pushes the result of calling a function
+  call,
+  // Pops the value of an expression statement
+  drop,
+  // Pops a value, and returns it
+  ret,
+  // Returns from the end of a function without a return statement
+  end,
+};
+
+// An instruction of the stack machine that evaluates functions
+struct Instruction {
+  Operation operation;
+  // The operator applied or assigned
+  OperatorType operator_type;
+  // The integer pushed (integer), or the index of the object (load, assign),
+  // or the number of operands (apply, call)
+  std::int64_t value;
+  // The function called (call)
+  const Function* function;
+};
+
+}  // namespace
+
+/*
+  The instructions of a function, or none if the function cannot be evaluated,
+  such as when it uses objects other than its parameters
+*/
+struct Evaluator::Program {
+  std::optional<std::vector<Instruction>> instructions;
+};
+
+namespace {
+
+/*
+  Appends the instructions that evaluate the expression, leaving its value on
+  the stack. Expressions are visited in post-order without recursion, so that
+  operands are evaluated from left to right, before their operator. Returns
+  false if the expression cannot be evaluated.
+*/
+bool compile_expression(const Function& function, const Expression& root,
+  std::vector<Instruction>& instructions)
+{
+  // Index of each object of the function
+  auto object_index = [&](const Object& object) -> std::optional<std::int64_t> {
+    const auto& objects = function.object_entities();
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+      if (objects[i].get() == &object) return static_cast<std::int64_t>(i);
+    }
+    return std::nullopt;
+  };
+
+  std::vector<std::pair<const Expression*, bool>> stack{{&root, false}};
+  while (!stack.empty()) {
+    auto [expression, expanded] = stack.back();
+    auto operator_expression =
+      dynamic_cast<const OperatorExpression*>(expression);
+    auto call_expression = dynamic_cast<const CallExpression*>(expression);
+    if (!expanded && (operator_expression || call_expression)) {
+      stack.back().second = true;
+      const auto& operands = operator_expression ?
+        operator_expression->expression_entities() :
+        call_expression->expression_entities();
+      // The object assigned by an assignment is not evaluated
+      std::size_t first = operator_expression &&
+        is_assignment(operator_expression->operator_type()) ? 1 : 0;
+      for (std::size_t i = operands.size(); i > first; --i) {
+        stack.emplace_back(operands[i - 1].get(), false);
+      }
+      continue;
+    }
+    stack.pop_back();
+
+    if (operator_expression) {
+      const auto& operands = operator_expression->expression_entities();
+      OperatorType operator_type = operator_expression->operator_type();
+      if (is_assignment(operator_type)) {
+        auto target =
+          static_cast<const ObjectExpression*>(operands.front().get());
+        std::optional<std::int64_t> index = object_index(*target->object());
+        if (!index) return false;
+        instructions.push_back(
+          Instruction{Operation::assign, operator_type, *index, nullptr});
+      } else {
+        instructions.push_back(Instruction{Operation::apply, operator_type,
+          static_cast<std::int64_t>(operands.size()), nullptr});
+      }
+    } else if (call_expression) {
+      instructions.push_back(Instruction{Operation::call, OperatorType{},
+        static_cast<std::int64_t>(
+          call_expression->expression_entities().size()),
+        call_expression->function().get()});
+    } else if (auto object_expression =
+      dynamic_cast<const ObjectExpression*>(expression))
+    {
+      std::optional<std::int64_t> index =
+        object_index(*object_expression->object());
+      if (!index) return false;
+      instructions.push_back(
+        Instruction{Operation::load, OperatorType{}, *index, nullptr});
+    } else if (auto integer_expression =
+      dynamic_cast<const IntegerExpression*>(expression))
+    {
+      instructions.push_back(Instruction{Operation::integer, OperatorType{},
+        integer_expression->value(), nullptr});
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+Evaluator::Evaluator(EvaluationLimits limits): limits_{limits} {}
+
+Evaluator::~Evaluator() = default;
+
+const Evaluator::Program& Evaluator::compile(const Function& function) {
+  std::unique_ptr<Program>& program = programs_[&function];
+  if (program) return *program;
+  program = std::make_unique<Program>();
+  std::vector<Instruction> instructions;
+  for (const auto& statement : function.statement_entities()) {
+    if (auto return_statement =
+      dynamic_cast<const ReturnStatement*>(statement.get()))
+    {
+      if (!return_statement->expression() || !compile_expression(
+        function, *return_statement->expression(), instructions))
+      {
+        return *program;
+      }
+      instructions.push_back(
+        Instruction{Operation::ret, OperatorType{}, 0, nullptr});
+    } else if (auto expression =
+      dynamic_cast<const Expression*>(statement.get()))
+    {
+      if (!compile_expression(function, *expression, instructions)) {
+        return *program;
+      }
+      instructions.push_back(
+        Instruction{Operation::drop, OperatorType{}, 0, nullptr});
+    } else {
+      return *program;
+    }
+  }
+  instructions.push_back(
+    Instruction{Operation::end, OperatorType{}, 0, nullptr});
+  program->instructions = std::move(instructions);
+  return *program;
+}
+
+std::optional<std::int64_t> Evaluator::call(
+  const Function& function, const std::vector<std::int64_t>& arguments)
+{
+  auto key = std::make_pair(&function, arguments);
+  auto memoized = results_.find(key);
+  if (memoized != results_.end()) return memoized->second;
+  if (!has_int_signature(function) ||
+    arguments.size() != function.object_entities().size())
+  {
+    return std::nullopt;
+  }
+
+  // A call in progress
+  struct Frame {
+    const Function* function;
+    const std::vector<Instruction>* instructions;
+    // Arguments of the call, which key its result
+    std::vector<std::int64_t> arguments;
+    // Index of the next instruction to run
+    std::size_t next;
+    // Values of the parameters, which are the only objects of a function
+    std::vector<std::int64_t> objects;
+    // Operands of the instructions
+    std::vector<std::int64_t> values;
+  };
+  std::vector<Frame> frames;
+  auto enter = [&](const Function& callee, std::vector<std::int64_t> values) {
+    const Program& program = compile(callee);
+    if (!program.instructions || frames.size() == limits_.depth) return false;
+    frames.push_back(
+      Frame{&callee, &*program.instructions, values, 0, values, {}});
+    return true;
+  };
+
+  /*
+    Calls that cannot be evaluated even with the full limits are memoized too,
+    but calls nested in them are not, since they may have been stopped only by
+    what their callers used up
+  */
+  std::optional<std::int64_t> result;
+  if (enter(function, arguments)) {
+    for (std::size_t steps = 0; steps < limits_.steps; ++steps) {
+      Frame& frame = frames.back();
+      const Instruction& instruction = (*frame.instructions)[frame.next++];
+      std::vector<std::int64_t>& values = frame.values;
+      bool failed = false;
+      switch (instruction.operation) {
+        case Operation::integer:
+          values.push_back(instruction.value);
+          break;
+        case Operation::load:
+          values.push_back(frame.objects[instruction.value]);
+          break;
+        case Operation::apply: {
+          // Operators apply from left to right
+          auto operands = values.end() - instruction.value;
+          std::optional<std::int64_t> value = *operands;
+          for (auto operand = operands + 1; value && operand != values.end();
+            ++operand)
+          {
+            value = evaluate(instruction.operator_type, *value, *operand);
+          }
+          values.erase(operands, values.end());
+          if (!value) {
+            failed = true;
+            break;
+          }
+          values.push_back(*value);
+          break;
+        }
+        case Operation::assign: {
+          std::int64_t& object = frame.objects[instruction.value];
+          std::optional<std::int64_t> value = values.back();
+          if (instruction.operator_type != OperatorType::assign) {
+            value = evaluate(instruction.operator_type, object, *value);
+          }
+          if (!value) {
+            failed = true;
+            break;
+          }
+          object = *value;
+          values.back() = *value;
+          break;
+        }
+        case Operation::call: {
+          const Function& callee = *instruction.function;
+          auto operands = values.end() - instruction.value;
+          std::vector<std::int64_t> callee_arguments{operands, values.end()};
+          values.erase(operands, values.end());
+          auto callee_result =
+            results_.find(std::make_pair(&callee, callee_arguments));
+          if (callee_result != results_.end()) {
+            if (!callee_result->second) {
+              failed = true;
+              break;
+            }
+            values.push_back(*callee_result->second);
+            break;
+          }
+          /*
+            Calls with the wrong number of arguments are only reported, so
+            they may still be here when bodies are parsed lazily
+          */
+          failed = !has_int_signature(callee) ||
+            callee_arguments.size() != callee.object_entities().size() ||
+            !enter(callee, std::move(callee_arguments));
+          break;
+        }
+        case Operation::drop:
+          values.pop_back();
+          break;
+        case Operation::end:
+          // Functions on ints must return an int
+          failed = true;
+          break;
+        case Operation::ret: {
+          std::int64_t value = values.back();
+          results_[std::make_pair(frame.function, std::move(frame.arguments))] =
+            value;
+          frames.pop_back();
+          if (frames.empty()) {
+            result = value;
+          } else {
+            frames.back().values.push_back(value);
+          }
+          break;
+        }
+      }
+      if (failed || result) break;
+    }
+  }
+  results_[key] = result;
+  return result;
+}
+
+void precompute_calls(Function& function, Evaluator& evaluator) {
+  /*
+    Replaces the call if it can be evaluated, returning the integer it is
+    replaced by, or nullptr if it is kept
+  */
+  auto precompute = [&](const Expression& expression) {
+    std::shared_ptr<IntegerExpression> integer;
+    auto call = dynamic_cast<const CallExpression*>(&expression);
+    if (!call || !call->function()->has_annotation("precomputed")) {
+      return integer;
+    }
+    std::vector<std::int64_t> arguments;
+    for (const auto& argument : call->expression_entities()) {
+      auto argument_integer =
+        dynamic_cast<const IntegerExpression*>(argument.get());
+      if (!argument_integer) return integer;
+      arguments.push_back(argument_integer->value());
+    }
+    std::optional<std::int64_t> result =
+      evaluator.call(*call->function(), arguments);
+    if (!result) return integer;
+    integer = std::make_shared<IntegerExpression>();
+    integer->set_value(*result);
+    integer->set_cls(call->function()->return_class());
+    return integer;
+  };
+
+  /*
+    Visit the expressions in post-order without recursion, so that the
+    arguments of a call are precomputed before the call itself
+  */
+  struct Frame {
+    Expression* expression;
+    EntityContainer<Expression>* container;
+    // Index of the next sub-expression to visit
+    std::size_t next;
+  };
+  auto frame = [](Expression* expression) {
+    return Frame{expression,
+      dynamic_cast<EntityContainer<Expression>*>(expression), 0};
+  };
+  const auto& statements = function.statement_entities();
+  for (std::size_t i = 0; i < statements.size(); ++i) {
+    auto return_statement =
+      std::dynamic_pointer_cast<ReturnStatement>(statements[i]);
+    std::shared_ptr<Expression> root = return_statement ?
+      return_statement->expression() :
+      std::dynamic_pointer_cast<Expression>(statements[i]);
+    if (!root) continue;
+
+    std::shared_ptr<Expression> replacement;
+    std::vector<Frame> stack{frame(root.get())};
+    while (!stack.empty()) {
+      Frame& top = stack.back();
+      if (top.container && top.next < top.container->entities().size()) {
+        stack.push_back(frame(top.container->entities()[top.next].get()));
+        continue;
+      }
+      std::shared_ptr<Expression> integer = precompute(*top.expression);
+      stack.pop_back();
+      if (stack.empty()) {
+        replacement = integer;
+        break;
+      }
+      Frame& parent = stack.back();
+      if (integer) parent.container->replace(parent.next, integer);
+      ++parent.next;
+    }
+
+    if (!replacement) continue;
+    if (return_statement) {
+      return_statement->set_expression(replacement);
+    } else {
+      function.replace(i, replacement);
+    }
+  }
+}
+
+void PrecomputePass::run_package(std::shared_ptr<Package> package) {
+  Evaluator evaluator;
+  for (const auto& function : package->function_entities()) {
+    precompute_calls(*function, evaluator);
+  }
+}
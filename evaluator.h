@@ -0,0 +1,106 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  The evaluator runs functions at compile time by interpreting their graph, so
+  that calls of functions annotated with @precomputed whose arguments are
+  known at compile time can be replaced by their result. Nothing is compiled
+  or loaded into the compiler, so evaluation works wherever the compiler runs.
+
+  Each function is first compiled into a list of instructions for a stack
+  machine, which is kept for later calls. Calls are run with an explicit stack
+  of frames rather than by recursion, so deeply recursive functions cannot
+  overflow the compiler's stack. Operations on ints follow the C code on the
+  target (see evaluate in constant_folding.h), and an operation whose result
+  is undefined in C stops the evaluation, leaving the call to run at run time.
+  Evaluation is also stopped when it takes too many steps or too many calls
+  are in progress at once, which bounds the time and memory it uses.
+
+  The result of every completed call is memoized by function and arguments,
+  so repeated calls, including those made while evaluating other calls, are
+  only evaluated once.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "graph.h"
+#include "pass_manager.h"
+
+// Bounds on the work done to evaluate a call
+struct EvaluationLimits {
+  // Instructions run, including those of the nested calls
+  std::size_t steps = 1000000;
+  // Calls in progress at once, each holding its parameters and operands
+  std::size_t depth = 10000;
+};
+
+// Evaluates calls of functions on ints at compile time. Not thread safe.
+class Evaluator {
+public:
+  explicit Evaluator(EvaluationLimits limits = {});
+  ~Evaluator();
+
+  /*
+    Returns the int returned by calling the function with the arguments, or
+    nothing if the call cannot be evaluated: the function does not take and
+    return ints, its behavior is undefined for the arguments, it does not
+    return, or it exceeds the limits.
+  */
+  std::optional<std::int64_t> call(
+    const Function& function, const std::vector<std::int64_t>& arguments);
+
+private:
+  struct Program;
+
+  const Program& compile(const Function& function);
+
+  EvaluationLimits limits_;
+  std::unordered_map<const Function*, std::unique_ptr<Program>> programs_;
+  // Results of completed calls, and of calls that could not be evaluated
+  std::map<std::pair<const Function*, std::vector<std::int64_t>>,
+    std::optional<std::int64_t>> results_;
+};
+
+/*
+  Replaces the calls in the function of functions annotated with @precomputed,
+  whose arguments are all integers, by the integer they return. Calls that
+  cannot be evaluated are kept.
+*/
+void precompute_calls(Function& function, Evaluator& evaluator);
+
+/*
+  Runs precompute_calls on each function of the package, registered as
+  "precompute". Arguments computed from constants become integers when the
+  fold-constants pass runs first. Evaluating a call reads the bodies of other
+  functions, so this is a package pass.
+*/
+class PrecomputePass : public Pass {
+public:
+  std::string name() const override { return "precompute"; }
+  PassGranularity granularity() const override {
+    return PassGranularity::package;
+  }
+  void run_package(std::shared_ptr<Package> package) override;
+};
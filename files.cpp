@@ -0,0 +1,51 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "files.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+std::optional<std::string> read_file(const std::string& path) {
+  std::ifstream ifs{path, std::ios::binary};
+  if (!ifs) return std::nullopt;
+  std::stringstream ss{};
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+WriteResult write_file_if_changed(
+  const std::string& path, const std::string& contents)
+{
+  std::optional<std::string> existing = read_file(path);
+  if (existing && *existing == contents) return WriteResult::unchanged;
+
+  // Unique, so that concurrent writers of the same file do not collide
+  static std::atomic<unsigned> next_temporary{0};
+  std::string temporary = path + ".tmp" + std::to_string(getpid()) + "." +
+    std::to_string(next_temporary++);
+  std::ofstream ofs{temporary, std::ios::binary | std::ios::trunc};
+  ofs.write(contents.data(), contents.size());
+  // Closing flushes the contents, and leaves ofs failed if any step failed
+  ofs.close();
+  if (!ofs || std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return WriteResult::failed;
+  }
+  return WriteResult::written;
+}
@@ -0,0 +1,48 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Helpers for reading and writing the files produced by the compiler. Outputs
+  are only written when their contents change, so that build tools comparing
+  modification times do not redo work that depends on them.
+*/
+
+#pragma once
+
+#include <optional>
+#include <string>
+
+// Outcome of writing a file
+enum class WriteResult {
+  // The file could not be written
+  failed,
+  // The file already had the same contents, and was left untouched
+  unchanged,
+  // The file was created or its contents were replaced
+  written,
+};
+
+// Returns the contents of the file, or nothing if it cannot be read
+std::optional<std::string> read_file(const std::string& path);
+
+/*
+  Writes contents to the file, unless the file already has exactly these
+  contents. The new contents are written to a temporary file first, which then
+  replaces the file, so readers never see a partially written file. The
+  temporary file is removed again if writing fails.
+*/
+WriteResult write_file_if_changed(
+  const std::string& path, const std::string& contents);
@@ -0,0 +1,74 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "graph.h"
+#include "hasher.h"
+
+namespace {
+
+// Pushes the entities contained in entity, if it is a container of EntityT
+template<typename EntityT>
+void push_contained(Entity* entity, std::vector<Entity*>& stack) {
+  if (auto container = dynamic_cast<EntityContainer<EntityT>*>(entity)) {
+    for (const auto& contained : container->entities()) {
+      stack.push_back(contained.get());
+    }
+  }
+}
+
+}  // namespace
+
+/*
+  Visits the graph with an explicit stack rather than recursion, since
+  expressions may be nested arbitrarily deep.
+*/
+void Package::freeze() {
+  hash(*this);
+  std::vector<Entity*> stack{this};
+  while (!stack.empty()) {
+    Entity* entity = stack.back();
+    stack.pop_back();
+    entity->frozen_ = true;
+    push_contained<Class>(entity, stack);
+    push_contained<Function>(entity, stack);
+    push_contained<Object>(entity, stack);
+    push_contained<Statement>(entity, stack);
+    push_contained<Expression>(entity, stack);
+    if (auto return_statement = dynamic_cast<ReturnStatement*>(entity)) {
+      if (return_statement->expression()) {
+        stack.push_back(return_statement->expression().get());
+      }
+    }
+  }
+}
+
+void release_expressions(std::vector<std::shared_ptr<Expression>> expressions)
+{
+  while (!expressions.empty()) {
+    std::shared_ptr<Expression> expression = std::move(expressions.back());
+    expressions.pop_back();
+    // Sub-expressions of an expression referenced elsewhere are kept alive
+    if (expression.use_count() > 1) continue;
+    if (auto container =
+      dynamic_cast<EntityContainer<Expression>*>(expression.get()))
+    {
+      for (auto& sub_expression : container->entities_) {
+        expressions.push_back(std::move(sub_expression));
+      }
+      container->entities_.clear();
+    }
+  }
+}
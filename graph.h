@@ -20,6 +20,10 @@
   other to indicate relationships between entities (functions have parameters,
   packages have functions, etc.).
 
+  Entities own the entities they contain through std::shared_ptr, and refer
+  back to their parent through std::weak_ptr, so dropping the last reference to
+  a package frees its whole graph.
+
   A diagram of the entity inheritance hierarchy is given below, with each type
   being a possible graph node.
 
@@ -31,6 +35,8 @@
     Statement
       ReturnStatement
       Expression
+        CallExpression
+        IntegerExpression
         ObjectExpression
         OperatorExpression
 */
@@ -38,15 +44,23 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 template<typename EntityT> class EntityContainer;
+class CallExpression;
 class Class;
 class Entity;
 class Expression;
 class Function;
+class IntegerExpression;
 class Object;
 class ObjectExpression;
 class OperatorExpression;
@@ -59,7 +73,37 @@ class Entity : public std::enable_shared_from_this<Entity> {
 public:
   // Gets or sets the entity name
   const std::string& name() const { return name_; }
-  void set_name(std::string name) { name_ = std::move(name); }
+  void set_name(std::string name) {
+    name_ = std::move(name);
+    invalidate_hash();
+  }
+
+  /*
+    Gets or sets the cached structural hash of the entity (see hasher.h). The
+    cached hash is only meaningful if has_hash() returns true.
+  */
+  bool has_hash() const { return has_hash_; }
+  std::uint64_t cached_hash() const { return hash_; }
+  void set_cached_hash(std::uint64_t hash) const {
+    hash_ = hash;
+    has_hash_ = true;
+  }
+
+  /*
+    Discards the cached hash of this entity and all of its ancestors. Must be
+    called whenever a property that contributes to the hash is modified, so it
+    also checks that the entity is not frozen.
+  */
+  void invalidate_hash();
+
+  /*
+    Whether the entity has been frozen (see Package::freeze). Frozen entities
+    must not be modified.
+  */
+  bool frozen() const { return frozen_; }
+
+  // The entity containing this entity, or nullptr if it is not contained
+  std::shared_ptr<Entity> parent() const { return parent_.lock(); }
 
   // Polymorphic
   virtual ~Entity() = default;
@@ -75,9 +119,16 @@ protected:
 private:
   // For setting parent-child relationships
   template<typename EntityT> friend class EntityContainer;
+  // For freezing
+  friend class Package;
+  // For setting the parent of the returned expression
+  friend class ReturnStatement;
 
   std::string name_;
-  std::shared_ptr<Entity> parent_;
+  std::weak_ptr<Entity> parent_;
+  mutable std::uint64_t hash_ = 0;
+  mutable bool has_hash_ = false;
+  bool frozen_ = false;
 };
 
 /*
@@ -101,10 +152,38 @@ public:
   // Removes entity from the list of contained entities
   void remove(std::shared_ptr<EntityT> entity);
 
+  // Replaces the contained entity at index with entity, in the same position
+  void replace(std::size_t index, std::shared_ptr<EntityT> entity);
+
+  // Removes all contained entities
+  void clear();
+
+protected:
+  /*
+    Moves out the contained entities, leaving their parent unchanged. Only for
+    use when the container is being destroyed.
+  */
+  std::vector<std::shared_ptr<EntityT>> release() {
+    return std::move(entities_);
+  }
+
 private:
+  // For destroying deeply nested expressions without recursion
+  friend void release_expressions(
+    std::vector<std::shared_ptr<Expression>> expressions);
+
   std::vector<std::shared_ptr<EntityT>> entities_;
 };
 
+/*
+  Destroys the expressions, along with any sub-expressions that are not
+  referenced elsewhere. Expressions may be nested arbitrarily deep, so rather
+  than letting each expression's destructor destroy its sub-expressions
+  recursively, the sub-expressions are moved out and destroyed from an
+  explicit stack.
+*/
+void release_expressions(std::vector<std::shared_ptr<Expression>> expressions);
+
 /*
   Packages are the top-level entity, containing all other types of entities
   (directly or indirectly). Different packages and their contained entities are
@@ -136,6 +215,21 @@ public:
   }
   using EntityContainer<Class>::remove;
   using EntityContainer<Function>::remove;
+
+  /*
+    Freezes the package and every entity it contains. Parsing and passes
+    modify the graph, but the later phases only read it, so once frozen the
+    graph is guaranteed to be immutable and may be read by any number of
+    threads at once without locking. Structural hashes are computed while
+    freezing, so readers never update cached hashes either, and any function
+    bodies that were not loaded yet are loaded first.
+
+    Readers of a frozen graph should hold entities by reference (or by
+    reference to the owning std::shared_ptr) rather than copying
+    std::shared_ptr, which avoids atomic reference count updates contending
+    between threads.
+  */
+  void freeze();
 };
 
 // Functions may be defined with different types of return semantics
@@ -170,32 +264,104 @@ public:
   using EntityContainer<Object>::add;
   using EntityContainer<Object>::remove;
 
-  // Methods for contained Statement entities (see EntityContainer)
+  /*
+    Methods for contained Statement entities (see EntityContainer). The body is
+    loaded first if necessary (see load_body).
+  */
   std::shared_ptr<Statement> get_statement(const std::string& name) const {
+    load_body();
     return EntityContainer<Statement>::get(name);
   }
   const std::vector<std::shared_ptr<Statement>>& statement_entities() const {
+    load_body();
     return EntityContainer<Statement>::entities();
   }
   using EntityContainer<Statement>::add;
   using EntityContainer<Statement>::remove;
+  using EntityContainer<Statement>::replace;
 
   // Gets or sets the return type
   ReturnType return_type() const { return return_type_; }
-  void set_return_type(ReturnType return_type) { return_type_ = return_type; }
+  void set_return_type(ReturnType return_type) {
+    return_type_ = return_type;
+    invalidate_hash();
+  }
 
   /*
     Gets or sets the class of the returned object. Not applicable for
     ReturnType::none.
   */
-  std::shared_ptr<Class> return_class() const { return return_class_; }
+  const std::shared_ptr<Class>& return_class() const { return return_class_; }
   void set_return_class(std::shared_ptr<Class> return_class) {
     return_class_ = return_class;
+    invalidate_hash();
+  }
+
+  /*
+    Sets a function that adds the statements of the body to this function, for
+    functions whose bodies are parsed lazily. Until the statements are needed,
+    only the signature of the function is available.
+  */
+  void set_body_loader(std::function<void(Function&)> body_loader) {
+    body_loader_ = std::move(body_loader);
+    body_loaded_ = false;
+  }
+
+  /*
+    Calls the body loader, if one was set and has not been called yet. This is
+    done implicitly whenever the statements are accessed, and must happen
+    before the graph is frozen. May be called from multiple threads at once;
+    the loader is only called once.
+  */
+  void load_body() const;
+
+  // Whether the statements are available without calling the body loader
+  bool body_loaded() const { return body_loaded_; }
+
+  /*
+    Discards the statements, leaving the function with an empty body, so that
+    their memory is freed once no longer referenced elsewhere. Used to
+    compile one function at a time, once a function's body is no longer
+    needed.
+  */
+  void release_body() {
+    load_body();
+    EntityContainer<Statement>::clear();
+  }
+
+  /*
+    Gets or sets whether the function is public, meaning other packages may
+    import it
+  */
+  bool is_public() const { return public_; }
+  void set_public(bool is_public) {
+    public_ = is_public;
+    invalidate_hash();
+  }
+
+  /*
+    Gets or adds the annotations of the function, in source order, such as
+    "precomputed" for "@precomputed". Passes use them to find the functions
+    they apply to.
+  */
+  const std::vector<std::string>& annotations() const { return annotations_; }
+  bool has_annotation(const std::string& annotation) const {
+    return std::find(annotations_.begin(), annotations_.end(), annotation) !=
+      annotations_.end();
+  }
+  void add_annotation(std::string annotation) {
+    annotations_.push_back(std::move(annotation));
+    invalidate_hash();
   }
 
 private:
   ReturnType return_type_;
+  bool public_ = false;
+  std::vector<std::string> annotations_;
   std::shared_ptr<Class> return_class_;
+  mutable std::function<void(Function&)> body_loader_;
+  mutable std::once_flag body_once_;
+  mutable std::atomic<bool> body_loaded_{true};
 };
 
 /*
@@ -203,7 +369,21 @@ private:
   program must have a class. Classes define the valid operations on an object,
   and any contained objects.
 */
-class Class : public virtual Entity {};
+class Class : public virtual Entity {
+public:
+  /*
+    Gets or sets whether the class is public, meaning other packages may
+    import it
+  */
+  bool is_public() const { return public_; }
+  void set_public(bool is_public) {
+    public_ = is_public;
+    invalidate_hash();
+  }
+
+private:
+  bool public_ = false;
+};
 
 /*
   Objects are the fundamental data entity within a program. Every piece of data
@@ -212,8 +392,11 @@ class Class : public virtual Entity {};
 class Object : public virtual Entity {
 public:
   // Gets or sets the class
-  std::shared_ptr<Class> cls() const { return cls_; }
-  void set_cls(std::shared_ptr<Class> cls) { cls_ = cls; }
+  const std::shared_ptr<Class>& cls() const { return cls_; }
+  void set_cls(std::shared_ptr<Class> cls) {
+    cls_ = cls;
+    invalidate_hash();
+  }
 
 private:
   std::shared_ptr<Class> cls_;
@@ -234,10 +417,10 @@ class Statement : public virtual Entity {};
 class ReturnStatement : public Statement {
 public:
   // Gets or sets the expression
-  std::shared_ptr<Expression> expression() const { return expression_; }
-  void set_expression(std::shared_ptr<Expression> expression) { 
-    expression_ = expression;
+  const std::shared_ptr<Expression>& expression() const {
+    return expression_;
   }
+  void set_expression(std::shared_ptr<Expression> expression);
 
 private:
   std::shared_ptr<Expression> expression_;
@@ -252,14 +435,63 @@ class Expression : public Statement {};
 
 // Type of operator that appears within an expression
 enum class OperatorType {
+  // The = binary operator
+  assign,
+  // The / binary operator
+  divide,
+  // The /= binary operator
+  divide_assign,
+  // The == binary operator
+  equal,
+  // The > binary operator
+  greater,
+  // The >= binary operator
+  greater_equal,
+  // The < binary operator
+  less,
+  // The <= binary operator
+  less_equal,
+  // The - binary operator
+  minus,
+  // The -= binary operator
+  minus_assign,
+  // The % binary operator
+  modulo,
+  // The %= binary operator
+  modulo_assign,
+  // The * binary operator
+  multiply,
+  // The *= binary operator
+  multiply_assign,
+  // The != binary operator
+  not_equal,
   // The + binary operator
   plus,
+  // The += binary operator
+  plus_assign,
 };
 
+// Whether the operator assigns to its first operand, such as = and +=
+inline bool is_assignment(OperatorType operator_type) {
+  switch (operator_type) {
+    case OperatorType::assign:
+    case OperatorType::divide_assign:
+    case OperatorType::minus_assign:
+    case OperatorType::modulo_assign:
+    case OperatorType::multiply_assign:
+    case OperatorType::plus_assign:
+      return true;
+    default:
+      return false;
+  }
+}
+
 /*
   An operator expression combines two or more sub-expressions with a common type
   of operator. For example, a+b is an operator expression of type "plus" and
-  sub-expressions "a" and "b".
+  sub-expressions "a" and "b". Operators are applied from left to right, so
+  a-b-c is a single operator expression of type "minus" with three
+  sub-expressions, meaning (a-b)-c.
 */
 class OperatorExpression :
   public Expression,
@@ -276,10 +508,15 @@ public:
   using EntityContainer<Expression>::add;
   using EntityContainer<Expression>::remove;
 
+  ~OperatorExpression() override {
+    release_expressions(EntityContainer<Expression>::release());
+  }
+
   // Gets or sets the operator type
   OperatorType operator_type() const { return operator_type_; }
   void set_operator_type(OperatorType operator_type) {
     operator_type_ = operator_type;
+    invalidate_hash();
   }
 
 private:
@@ -293,17 +530,117 @@ private:
 class ObjectExpression : public Expression {
 public:
   // Gets or sets the object
-  std::shared_ptr<Object> object() const { return object_; }
-  void set_object(std::shared_ptr<Object> object) { object_ = object; }
+  const std::shared_ptr<Object>& object() const { return object_; }
+  void set_object(std::shared_ptr<Object> object) {
+    object_ = object;
+    invalidate_hash();
+  }
 private:
   std::shared_ptr<Object> object_;
 };
 
+/*
+  An integer expression evaluates to a constant integer of class int, given by
+  an integer literal in the source code, or computed by the compiler. For
+  example, "5" is an integer expression.
+*/
+class IntegerExpression : public Expression {
+public:
+  // Gets or sets the value
+  std::int64_t value() const { return value_; }
+  void set_value(std::int64_t value) {
+    value_ = value;
+    invalidate_hash();
+  }
+
+  // Gets or sets the class of the value (the built in class int)
+  const std::shared_ptr<Class>& cls() const { return cls_; }
+  void set_cls(std::shared_ptr<Class> cls) {
+    cls_ = cls;
+    invalidate_hash();
+  }
+
+private:
+  std::int64_t value_ = 0;
+  std::shared_ptr<Class> cls_;
+};
+
+/*
+  A call expression calls a function with a list of argument expressions, one
+  for each parameter of the function, and evaluates to the returned object. For
+  example, "sum(a, b)" is a call expression of function "sum" and argument
+  expressions "a" and "b".
+*/
+class CallExpression :
+  public Expression,
+  public EntityContainer<Expression>
+{
+public:
+  // Methods for contained Expression entities (see EntityContainer)
+  const std::vector<std::shared_ptr<Expression>>& expression_entities() const {
+    return EntityContainer<Expression>::entities();
+  }
+  using EntityContainer<Expression>::add;
+  using EntityContainer<Expression>::remove;
+
+  ~CallExpression() override {
+    release_expressions(EntityContainer<Expression>::release());
+  }
+
+  // Gets or sets the called function
+  const std::shared_ptr<Function>& function() const { return function_; }
+  void set_function(std::shared_ptr<Function> function) {
+    function_ = function;
+    invalidate_hash();
+  }
+
+private:
+  std::shared_ptr<Function> function_;
+};
+
+inline void Function::load_body() const {
+  if (body_loaded_) return;
+  std::call_once(body_once_, [this] {
+    std::function<void(Function&)> body_loader = std::move(body_loader_);
+    body_loader(const_cast<Function&>(*this));
+    body_loaded_ = true;
+  });
+}
+
+/*
+  The expression is contained like the sub-expressions of an EntityContainer,
+  so that modifying it discards the cached hashes of the statement and its
+  function
+*/
+inline void ReturnStatement::set_expression(
+  std::shared_ptr<Expression> expression)
+{
+  if (expression_) expression_->parent_.reset();
+  expression_ = expression;
+  if (expression_) expression_->parent_ = shared_from_this();
+  invalidate_hash();
+}
+
+/*
+  An entity whose cached hash is discarded implies that all of its ancestors
+  have also been discarded, so the walk stops at the first entity without one.
+*/
+inline void Entity::invalidate_hash() {
+  assert(!frozen_ && "frozen entities must not be modified");
+  if (!has_hash_) return;
+  has_hash_ = false;
+  for (std::shared_ptr<Entity> entity = parent_.lock();
+    entity && entity->has_hash_; entity = entity->parent_.lock())
+  {
+    entity->has_hash_ = false;
+  }
+}
+
 template<typename EntityT>
 std::shared_ptr<EntityT> EntityContainer<EntityT>::get(
   const std::string& name) const
 {
-  for (auto entity : entities_) {
+  for (const auto& entity : entities_) {
     if (entity->name() == name) {
       return entity;
     }
@@ -315,6 +652,7 @@ template<typename EntityT>
 void EntityContainer<EntityT>::add(std::shared_ptr<EntityT> entity) {
   entities_.push_back(entity);
   entity->parent_ = shared_from_this();
+  invalidate_hash();
 }
 
 template<typename EntityT>
@@ -322,6 +660,26 @@ void EntityContainer<EntityT>::remove(std::shared_ptr<EntityT> entity) {
   auto iterator = std::find(entities_.begin(), entities_.end(), entity);
   if (iterator != entities_.end()) {
     entities_.erase(iterator);
-    iterator->parent_ = nullptr;
+    entity->parent_.reset();
+    invalidate_hash();
+  }
+}
+
+template<typename EntityT>
+void EntityContainer<EntityT>::replace(
+  std::size_t index, std::shared_ptr<EntityT> entity)
+{
+  entities_[index]->parent_.reset();
+  entities_[index] = entity;
+  entity->parent_ = shared_from_this();
+  invalidate_hash();
+}
+
+template<typename EntityT>
+void EntityContainer<EntityT>::clear() {
+  for (const auto& entity : entities_) {
+    entity->parent_.reset();
   }
+  entities_.clear();
+  invalidate_hash();
 }
\ No newline at end of file
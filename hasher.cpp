@@ -0,0 +1,253 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "hasher.h"
+#include <utility>
+#include <vector>
+
+namespace {
+
+/*
+  Each kind of entity mixes a distinct tag into its hash, so that entities of
+  different kinds with otherwise identical contents hash differently.
+*/
+enum class HashTag : std::uint8_t {
+  call_expression,
+  cls,
+  function,
+  integer_expression,
+  object,
+  object_expression,
+  operator_expression,
+  package,
+  return_statement,
+  statement,
+};
+
+/*
+  Accumulates a hash from a sequence of values. Integers are always mixed in
+  little-endian byte order and strings are prefixed by their length, so the
+  result does not depend on the host platform.
+*/
+class Hasher {
+public:
+  explicit Hasher(HashTag tag) { add(static_cast<std::uint64_t>(tag)); }
+
+  void add(std::uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+      bytes[i] = static_cast<unsigned char>(value >> (i * 8));
+    }
+    hash_ = hash_bytes(bytes, sizeof(bytes), hash_);
+  }
+
+  void add(const std::string& text) {
+    add(static_cast<std::uint64_t>(text.size()));
+    hash_ = hash_bytes(text.data(), text.size(), hash_);
+  }
+
+  std::uint64_t result() const { return hash_; }
+
+private:
+  std::uint64_t hash_ = hash_seed;
+};
+
+// Returns the cached hash of entity, computing and caching it if necessary
+template<typename ComputeT>
+std::uint64_t cached(const Entity& entity, ComputeT compute) {
+  if (!entity.has_hash()) {
+    entity.set_cached_hash(compute());
+  }
+  return entity.cached_hash();
+}
+
+/*
+  Adds the name of the package that contains the class or function, which
+  tells apart entities of the same name in different packages
+*/
+void add_package_name(Hasher& hasher, const Entity& entity) {
+  std::shared_ptr<Entity> package = entity.parent();
+  hasher.add(package ? package->name() : std::string{});
+}
+
+}  // namespace
+
+std::uint64_t hash_bytes(
+  const void* data, std::size_t size, std::uint64_t seed)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  std::uint64_t hash = seed;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::uint64_t hash(const Package& package) {
+  return cached(package, [&] {
+    Hasher hasher{HashTag::package};
+    hasher.add(package.name());
+    hasher.add(package.class_entities().size());
+    for (const auto& cls : package.class_entities()) {
+      hasher.add(hash(*cls));
+    }
+    hasher.add(package.function_entities().size());
+    for (const auto& function : package.function_entities()) {
+      hasher.add(hash(*function));
+    }
+    return hasher.result();
+  });
+}
+
+std::uint64_t hash(const Function& function) {
+  return cached(function, [&] {
+    Hasher hasher{HashTag::function};
+    add_package_name(hasher, function);
+    hasher.add(function.name());
+    hasher.add(function.is_public());
+    hasher.add(function.annotations().size());
+    for (const std::string& annotation : function.annotations()) {
+      hasher.add(annotation);
+    }
+    hasher.add(static_cast<std::uint64_t>(function.return_type()));
+    if (function.return_type() == ReturnType::value) {
+      hasher.add(hash(*function.return_class()));
+    }
+    hasher.add(function.object_entities().size());
+    for (const auto& object : function.object_entities()) {
+      hasher.add(hash(*object));
+    }
+    hasher.add(function.statement_entities().size());
+    for (const auto& statement : function.statement_entities()) {
+      hasher.add(hash(*statement));
+    }
+    return hasher.result();
+  });
+}
+
+std::uint64_t hash(const Class& cls) {
+  return cached(cls, [&] {
+    Hasher hasher{HashTag::cls};
+    add_package_name(hasher, cls);
+    hasher.add(cls.name());
+    hasher.add(cls.is_public());
+    return hasher.result();
+  });
+}
+
+std::uint64_t hash(const Object& object) {
+  return cached(object, [&] {
+    Hasher hasher{HashTag::object};
+    hasher.add(object.name());
+    hasher.add(hash(*object.cls()));
+    return hasher.result();
+  });
+}
+
+std::uint64_t hash(const Statement& statement) {
+  if (auto expression = dynamic_cast<const Expression*>(&statement)) {
+    return hash(*expression);
+  }
+  return cached(statement, [&] {
+    if (auto return_statement =
+      dynamic_cast<const ReturnStatement*>(&statement))
+    {
+      // Recovering from a parse error may leave a return without expression
+      const std::shared_ptr<Expression>& expression =
+        return_statement->expression();
+      Hasher hasher{HashTag::return_statement};
+      hasher.add(expression != nullptr);
+      if (expression) hasher.add(hash(*expression));
+      return hasher.result();
+    }
+    return Hasher{HashTag::statement}.result();
+  });
+}
+
+/*
+  Expressions may be nested arbitrarily deep, so instead of recursing, they are
+  hashed in post-order using an explicit stack. Each entry records whether the
+  sub-expressions of the expression have already been pushed, in which case
+  they have all been hashed by the time the entry is reached again.
+*/
+std::uint64_t hash(const Expression& root) {
+  std::vector<std::pair<const Expression*, bool>> stack{{&root, false}};
+  while (!stack.empty()) {
+    auto [expression, expanded] = stack.back();
+    if (expression->has_hash()) {
+      stack.pop_back();
+      continue;
+    }
+    auto container =
+      dynamic_cast<const EntityContainer<Expression>*>(expression);
+    if (container && !expanded) {
+      stack.back().second = true;
+      for (const auto& sub_expression : container->entities()) {
+        stack.emplace_back(sub_expression.get(), false);
+      }
+      continue;
+    }
+    stack.pop_back();
+
+    if (auto operator_expression =
+      dynamic_cast<const OperatorExpression*>(expression))
+    {
+      Hasher hasher{HashTag::operator_expression};
+      hasher.add(static_cast<std::uint64_t>(
+        operator_expression->operator_type()));
+      hasher.add(operator_expression->expression_entities().size());
+      for (const auto& sub_expression :
+        operator_expression->expression_entities())
+      {
+        hasher.add(sub_expression->cached_hash());
+      }
+      expression->set_cached_hash(hasher.result());
+    } else if (auto call_expression =
+      dynamic_cast<const CallExpression*>(expression))
+    {
+      /*
+        The called function is identified by its package and name rather
+        than by its hash, since hashing it would include its body, which may
+        call back into the function being hashed.
+      */
+      Hasher hasher{HashTag::call_expression};
+      add_package_name(hasher, *call_expression->function());
+      hasher.add(call_expression->function()->name());
+      hasher.add(call_expression->expression_entities().size());
+      for (const auto& argument : call_expression->expression_entities()) {
+        hasher.add(argument->cached_hash());
+      }
+      expression->set_cached_hash(hasher.result());
+    } else if (auto integer_expression =
+      dynamic_cast<const IntegerExpression*>(expression))
+    {
+      Hasher hasher{HashTag::integer_expression};
+      hasher.add(static_cast<std::uint64_t>(integer_expression->value()));
+      hasher.add(hash(*integer_expression->cls()));
+      expression->set_cached_hash(hasher.result());
+    } else {
+      Hasher hasher{HashTag::object_expression};
+      if (auto object_expression =
+        dynamic_cast<const ObjectExpression*>(expression))
+      {
+        hasher.add(hash(*object_expression->object()));
+      }
+      expression->set_cached_hash(hasher.result());
+    }
+  }
+  return root.cached_hash();
+}
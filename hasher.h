@@ -0,0 +1,65 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Functions for computing structural hashes of graph entities. A structural hash
+  covers everything about an entity that affects the meaning of the program:
+  its name, its signature, its body, and the hashes of the entities it
+  references. Classes and functions are also identified by the name of their
+  package, since packages may use the same names. Entities with identical structure hash equal even if they belong
+  to different graphs, and hashes are stable between compiler runs, so they may
+  be used to key on-disk caches.
+
+  Hashes are computed on demand and cached on each entity. Modifying an entity
+  through the graph API discards the cached hash of the entity and its
+  ancestors (see Entity::invalidate_hash), so only the modified parts of the
+  graph are rehashed. Referenced entities that are not descendants (such as the
+  class of an object) are hashed by value, and do not invalidate the entities
+  that reference them.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "graph.h"
+
+// Starting value for hash_bytes, when not continuing a previous hash
+constexpr std::uint64_t hash_seed = 14695981039346656037ull;
+
+// Hashes size bytes of data, continuing from seed (64-bit FNV-1a)
+std::uint64_t hash_bytes(
+  const void* data, std::size_t size, std::uint64_t seed = hash_seed);
+
+/*
+  These functions return the structural hash of the given graph entity,
+  computing and caching the hashes of any child entities that are not already
+  cached.
+*/
+std::uint64_t hash(const Package& package);
+std::uint64_t hash(const Function& function);
+std::uint64_t hash(const Class& cls);
+std::uint64_t hash(const Object& object);
+std::uint64_t hash(const Statement& statement);
+std::uint64_t hash(const Expression& expression);
+
+// Overloads for entities held by std::shared_ptr
+template<typename EntityT>
+std::uint64_t hash(const std::shared_ptr<EntityT>& entity) {
+  return hash(*entity);
+}
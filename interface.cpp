@@ -0,0 +1,102 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "interface.h"
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Appends the declaration of the function, without its body
+void append_function(const Function& function, std::string& text) {
+  for (const std::string& annotation : function.annotations()) {
+    text += '@';
+    text += annotation;
+    text += ' ';
+  }
+  text += "pub func ";
+  text += function.name();
+  text += '(';
+  const auto& objects = function.object_entities();
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    if (i > 0) text += ", ";
+    text += objects[i]->cls()->name();
+    text += ' ';
+    text += objects[i]->name();
+  }
+  text += ')';
+  if (function.return_type() == ReturnType::value) {
+    text += " -> ";
+    text += function.return_class()->name();
+  }
+  text += ";\n";
+}
+
+}  // namespace
+
+std::string print_interface(const std::shared_ptr<Package>& package) {
+  // Classes referred to by public signatures
+  std::set<const Class*> referred;
+  for (const auto& function : package->function_entities()) {
+    if (!function->is_public()) continue;
+    for (const auto& object : function->object_entities()) {
+      referred.insert(object->cls().get());
+    }
+    if (function->return_type() == ReturnType::value) {
+      referred.insert(function->return_class().get());
+    }
+  }
+
+  std::string text;
+  text += "package ";
+  text += package->name();
+  text += ";\n";
+
+  // Classes of other packages, sorted so the text only depends on the package
+  std::set<std::pair<std::string, std::string>> imports;
+  for (const Class* cls : referred) {
+    std::shared_ptr<Entity> parent = cls->parent();
+    if (parent && parent.get() != package.get()) {
+      imports.emplace(parent->name(), cls->name());
+    }
+  }
+  for (const auto& [package_name, name] : imports) {
+    text += "import ";
+    text += package_name;
+    text += '.';
+    text += name;
+    text += ";\n";
+  }
+
+  // Built in classes are declared in every package already
+  for (const auto& cls : package->class_entities()) {
+    if (cls->name() == "int") continue;
+    if (cls->is_public()) {
+      text += "pub class ";
+    } else if (referred.count(cls.get())) {
+      text += "class ";
+    } else {
+      continue;
+    }
+    text += cls->name();
+    text += " {}\n";
+  }
+  for (const auto& function : package->function_entities()) {
+    if (function->is_public()) append_function(*function, text);
+  }
+  return text;
+}
@@ -0,0 +1,47 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  A package interface describes what other packages may use from a package:
+  its public classes, and the signatures of its public functions. Interfaces
+  are written in the language itself, as a source file with the function
+  bodies left out, so they are loaded with the same parser as sources (see
+  Parser::set_interface).
+
+  Packages that import a package only need its interface, so each package can
+  be compiled separately, reading the interfaces of its imports instead of
+  parsing their sources. The interface only changes when the public entities
+  of the package change, not when function bodies or non-public entities do,
+  so as long as it is only written when changed (see files.h), dependent
+  packages are not rebuilt for such changes.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "graph.h"
+
+// File extension of package interfaces, after the package name
+constexpr const char* interface_extension = ".vi";
+
+/*
+  Returns the interface of the package. Besides the public entities, it
+  declares the non-public classes that public signatures refer to, and imports
+  the classes of other packages that they refer to, without making either of
+  them importable.
+*/
+std::string print_interface(const std::shared_ptr<Package>& package);
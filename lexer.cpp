@@ -21,18 +21,35 @@
 enum class LexerState {
   // Either CR or CRLF, both of which indicate a single newline
   cr_or_crlf,
-  // Either / (division), // (single-line comment), or /* (multi line comment)
+  // Either / (division), /= (assignment), // (single-line comment), or /*
+  // (multi line comment)
   divide_or_comment,
+  // Either = (assignment) or == (comparison)
+  equal_or_equal_equal,
+  // Either > or >=
+  greater_or_greater_equal,
   // String of [A-Za-z_][A-Za-z0-9_]*. Either an identifier or keyword.
   identifier_or_keyword,
-  // Either - (minus) or -> (arrow)
+  // String of [0-9]+, an integer literal
+  integer,
+  // Either < or <=
+  less_or_less_equal,
+  // Either - (minus), -= (assignment), or -> (arrow)
   minus_or_arrow,
+  // Either % or %=
+  modulo_or_modulo_equal,
   // Currently in a multi-line comment
   multi_line_comment,
   // Either CR or CRLF, but inside a multi-line comment
   multi_line_comment_cr_or_crlf,
   // Encountered *, will end multi-line comment if next char is /
   multi_line_comment_maybe_end,
+  // Either * or *=
+  multiply_or_multiply_equal,
+  // Encountered !, which must be followed by = (comparison)
+  not_equal,
+  // Either + or +=
+  plus_or_plus_equal,
   // Currently in a single-line comment, terminated on newline
   single_line_comment,
   // Start of a new lexeme
@@ -45,7 +62,9 @@ Lexer::Lexer(std::string source):
   index_{0},
   line_number_{1},
   column_number_{1},
-  columns_per_tab_{2}
+  columns_per_tab_{2},
+  publish_{nullptr},
+  batch_size_{0}
 {}
 
 /*
@@ -54,7 +73,11 @@ Lexer::Lexer(std::string source):
 */
 TokenType get_keyword_token_type(const std::string& lexeme) {
   static const std::map<std::string, TokenType> keyword_to_token_type {
+    {"class", TokenType::class_keyword},
     {"func", TokenType::func_keyword},
+    {"import", TokenType::import_keyword},
+    {"package", TokenType::package_keyword},
+    {"pub", TokenType::pub_keyword},
     {"return", TokenType::return_keyword},
   };
   const auto iter = keyword_to_token_type.find(lexeme);
@@ -96,12 +119,25 @@ std::vector<Token> Lexer::run()
             advance_char();
             state_ = LexerState::multi_line_comment;
             break;
+          case '=':
+            advance_char();
+            add_token(TokenType::divide_equal);
+            state_ = LexerState::start;
+            break;
           default:
             add_token(TokenType::divide);
             state_ = LexerState::start;
             break;
         }
         break;
+      case LexerState::equal_or_equal_equal:
+        add_token_or_equal(TokenType::equal, TokenType::equal_equal);
+        state_ = LexerState::start;
+        break;
+      case LexerState::greater_or_greater_equal:
+        add_token_or_equal(TokenType::greater, TokenType::greater_equal);
+        state_ = LexerState::start;
+        break;
       case LexerState::identifier_or_keyword:
         if (isalnum(current_char()) || current_char() == '_') {
           advance_char();
@@ -111,15 +147,31 @@ std::vector<Token> Lexer::run()
           state_ = LexerState::start;
         }
         break;
+      case LexerState::integer:
+        if (isdigit(current_char())) {
+          advance_char();
+        } else {
+          add_token(TokenType::integer);
+          state_ = LexerState::start;
+        }
+        break;
+      case LexerState::less_or_less_equal:
+        add_token_or_equal(TokenType::less, TokenType::less_equal);
+        state_ = LexerState::start;
+        break;
       case LexerState::minus_or_arrow:
         if (current_char() == '>') {
           advance_char();
           add_token(TokenType::arrow);
         } else {
-          add_token(TokenType::minus);
+          add_token_or_equal(TokenType::minus, TokenType::minus_equal);
         }
         state_ = LexerState::start;
         break;
+      case LexerState::modulo_or_modulo_equal:
+        add_token_or_equal(TokenType::modulo, TokenType::modulo_equal);
+        state_ = LexerState::start;
+        break;
       case LexerState::multi_line_comment:
         switch (current_char()) {
           case '\n':
@@ -154,6 +206,18 @@ std::vector<Token> Lexer::run()
           state_ = LexerState::multi_line_comment;
         }
         break;
+      case LexerState::multiply_or_multiply_equal:
+        add_token_or_equal(TokenType::multiply, TokenType::multiply_equal);
+        state_ = LexerState::start;
+        break;
+      case LexerState::not_equal:
+        add_token_or_equal(TokenType::unknown, TokenType::not_equal);
+        state_ = LexerState::start;
+        break;
+      case LexerState::plus_or_plus_equal:
+        add_token_or_equal(TokenType::plus, TokenType::plus_equal);
+        state_ = LexerState::start;
+        break;
       case LexerState::single_line_comment:
         switch (current_char()) {
           case '\n':
@@ -177,20 +241,43 @@ std::vector<Token> Lexer::run()
           state_ = LexerState::identifier_or_keyword;
           break;
         }
+        if (isdigit(current_char())) {
+          advance_char();
+          state_ = LexerState::integer;
+          break;
+        }
         switch (current_char()) {
           case '+':
             advance_char();
-            add_token(TokenType::plus);
-            state_ = LexerState::start;
+            state_ = LexerState::plus_or_plus_equal;
             break;
           case '*':
             advance_char();
-            add_token(TokenType::multiply);
-            state_ = LexerState::start;
+            state_ = LexerState::multiply_or_multiply_equal;
             break;
           case '%':
             advance_char();
-            add_token(TokenType::modulo);
+            state_ = LexerState::modulo_or_modulo_equal;
+            break;
+          case '=':
+            advance_char();
+            state_ = LexerState::equal_or_equal_equal;
+            break;
+          case '!':
+            advance_char();
+            state_ = LexerState::not_equal;
+            break;
+          case '<':
+            advance_char();
+            state_ = LexerState::less_or_less_equal;
+            break;
+          case '>':
+            advance_char();
+            state_ = LexerState::greater_or_greater_equal;
+            break;
+          case '@':
+            advance_char();
+            add_token(TokenType::at);
             state_ = LexerState::start;
             break;
           case ',':
@@ -198,6 +285,11 @@ std::vector<Token> Lexer::run()
             add_token(TokenType::comma);
             state_ = LexerState::start;
             break;
+          case '.':
+            advance_char();
+            add_token(TokenType::dot);
+            state_ = LexerState::start;
+            break;
           case ';':
             advance_char();
             add_token(TokenType::semicolon);
@@ -249,6 +341,10 @@ std::vector<Token> Lexer::run()
           case '\0':
             add_token(TokenType::end);
             return std::move(tokens_);
+          default:
+            advance_char();
+            add_token(TokenType::unknown);
+            break;
         }
         break;
     }
@@ -288,8 +384,41 @@ std::string Lexer::get_lexeme() {
   return std::string{source_, start_index_, size};
 }
 
-// Appends a new token of the given type to the result list
+void Lexer::run(const std::function<void(std::vector<Token>)>& publish,
+  std::size_t batch_size)
+{
+  publish_ = &publish;
+  batch_size_ = batch_size;
+  std::vector<Token> tokens = run();
+  publish_ = nullptr;
+  publish(std::move(tokens));
+}
+
+/*
+  Appends a new token of the given type to the result list, first publishing
+  the list if it is a full batch
+*/
 Token& Lexer::add_token(TokenType token_type) {
+  if (publish_ && tokens_.size() == batch_size_) {
+    (*publish_)(std::move(tokens_));
+    tokens_ = std::vector<Token>{};
+    tokens_.reserve(batch_size_);
+  }
   return tokens_.emplace_back(
     Token{token_type, get_lexeme(), start_line_number_, start_column_number_});
+}
+
+/*
+  Appends a token of type equal_token_type if the current character is =,
+  consuming it, or otherwise a token of type token_type
+*/
+void Lexer::add_token_or_equal(
+  TokenType token_type, TokenType equal_token_type)
+{
+  if (current_char() == '=') {
+    advance_char();
+    add_token(equal_token_type);
+  } else {
+    add_token(token_type);
+  }
 }
\ No newline at end of file
@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <vector>
 #include "token.h"
@@ -53,6 +55,15 @@ public:
   */
   std::vector<Token> run();
 
+  /*
+    Runs the lexer, passing the tokens to publish in order, in batches of
+    batch_size tokens as they are produced, so that another thread can parse
+    the tokens while the rest are being lexed. The final batch may be smaller,
+    and ends with the token of type TokenType::end.
+  */
+  void run(const std::function<void(std::vector<Token>)>& publish,
+    std::size_t batch_size);
+
 private:
   void start_lexeme();
   char current_char() const { return source_[index_]; }
@@ -61,6 +72,7 @@ private:
   void advance_tab();
   std::string get_lexeme();
   Token& add_token(TokenType token_type);
+  void add_token_or_equal(TokenType token_type, TokenType equal_token_type);
 
   std::string source_;
   LexerState state_;
@@ -72,4 +84,6 @@ private:
   int start_column_number_;
   int columns_per_tab_;
   std::vector<Token> tokens_;
+  const std::function<void(std::vector<Token>)>* publish_;
+  std::size_t batch_size_;
 };
\ No newline at end of file
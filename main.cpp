@@ -22,18 +22,206 @@
   Phases:
   - Lexer: source code to tokens
   - Parser: tokens to graph
+  - Passes: analyses and transformations of the graph
   - Translator: graph to C code
+
+  Usage: veil [options] [file or directory...]
+  The given files, or the ".v" files of the given directories, make up the
+  main package (default: input.v).
+  Options:
+    --build          Compiles the C code written to --output-dir with the C
+                     compiler, running --jobs compilers at once, and links it
+                     into the executable NAME in --output-dir, along with the
+                     C code of the packages loaded from interfaces, which
+                     must have been written to the same --output-dir. Objects
+                     are cached, in --cache-dir if given or in the "objects"
+                     subdirectory of --output-dir otherwise, and only sources
+                     whose code changed are compiled again.
+    --cache-dir DIR  Caches the C code of each function in DIR, and reuses it
+                     for functions that did not change, printing the number
+                     of cache hits and misses to standard error
+    --cc COMMAND     C compiler used by --build (default: $CC, or cc)
+    --cflags FLAGS   Flags for compiling with --build (default: -O2)
+    --import-path DIR
+                     Searches DIR for imported packages, each package being a
+                     subdirectory (may be repeated, default: the directory
+                     containing the main package)
+    --interface-dir DIR
+                     Loads imported packages from their interfaces in DIR if
+                     present, and writes the interface of the main package
+                     to DIR. Their classes and functions are declared in the
+                     C code, but their functions are not translated again.
+    --jobs N         Number of worker threads, and of C compilers run at once
+                     by --build (default: one per core)
+    --lazy           Parses function bodies only when they are needed
+    --ldflags FLAGS  Flags for linking with --build (default: none)
+    --output-dir DIR Writes the C code to DIR instead of standard output, as a
+                     header NAME.h and source files NAME_0.c, NAME_1.c, ...,
+                     named after the main package
+    --parallel-parse Parses function bodies in parallel
+    --pass NAME      Runs the named pass after parsing (may be repeated), such
+                     as fold-constants or precompute
+    --plugin PATH    Loads passes from a plugin library (may be repeated)
+    --shards N       Number of source files written to --output-dir, which
+                     may be compiled in parallel (default: 1)
+    --stream         Lexes, parses, and translates concurrently, one function
+                     at a time, releasing each function body once translated,
+                     and prints only the C code (cannot be combined with
+                     --parallel-parse or --pass)
+    --summary        Prints the graph without function bodies
+    --time-passes    Prints the time spent in each pass
 */
 
-#include <fstream>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
-#include <sstream>
-#include "lexer.h"
-#include "parser.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "c_compiler.h"
+#include "diagnostics.h"
+#include "files.h"
+#include "interface.h"
+#include "module_loader.h"
+#include "output_buffer.h"
+#include "pass_manager.h"
 #include "printer.h"
+#include "spsc_ring.h"
+#include "thread_pool.h"
 #include "token.h"
+#include "translation_cache.h"
 #include "translator.h"
 
+// Amount of C code that is collected before writing it out while streaming
+constexpr std::size_t output_flush_size = 1024 * 1024;
+
+// Settings given on the command line
+struct Options {
+  std::vector<std::string> inputs;
+  bool build = false;
+  std::string cache_dir;
+  std::string cc;
+  std::string cflags = "-O2";
+  std::vector<std::string> import_paths;
+  std::string interface_dir;
+  std::size_t jobs = 0;
+  bool lazy = false;
+  std::string ldflags;
+  std::string output_dir;
+  bool parallel_parse = false;
+  std::vector<std::string> passes;
+  std::vector<std::string> plugins;
+  std::size_t shards = 0;
+  bool stream = false;
+  bool summary = false;
+  bool time_passes = false;
+};
+
+// Prints an error message about the command line, and exits
+[[noreturn]] void fail_usage(const std::string& message) {
+  std::cerr << "error: " << message << std::endl;
+  std::exit(EXIT_FAILURE);
+}
+
+// Parses the command line arguments into options
+Options parse_options(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    auto value = [&]() -> std::string {
+      if (i + 1 == argc) fail_usage("missing value for " + arg);
+      return argv[++i];
+    };
+    // Parses the value as a count, rejecting anything else
+    auto count = [&]() -> std::size_t {
+      std::string text = value();
+      if (!text.empty() &&
+        text.find_first_not_of("0123456789") == std::string::npos)
+      {
+        try {
+          return std::stoul(text);
+        } catch (const std::out_of_range&) {}
+      }
+      fail_usage("invalid value \"" + text + "\" for " + arg);
+    };
+    if (arg == "--build") {
+      options.build = true;
+    } else if (arg == "--cache-dir") {
+      options.cache_dir = value();
+    } else if (arg == "--cc") {
+      options.cc = value();
+    } else if (arg == "--cflags") {
+      options.cflags = value();
+    } else if (arg == "--import-path") {
+      options.import_paths.push_back(value());
+    } else if (arg == "--interface-dir") {
+      options.interface_dir = value();
+    } else if (arg == "--jobs") {
+      options.jobs = count();
+    } else if (arg == "--lazy") {
+      options.lazy = true;
+    } else if (arg == "--ldflags") {
+      options.ldflags = value();
+    } else if (arg == "--output-dir") {
+      options.output_dir = value();
+    } else if (arg == "--parallel-parse") {
+      options.parallel_parse = true;
+    } else if (arg == "--pass") {
+      options.passes.push_back(value());
+    } else if (arg == "--plugin") {
+      options.plugins.push_back(value());
+    } else if (arg == "--shards") {
+      options.shards = count();
+    } else if (arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "--summary") {
+      options.summary = true;
+    } else if (arg == "--time-passes") {
+      options.time_passes = true;
+    } else if (arg.rfind("--", 0) == 0) {
+      fail_usage("unknown option " + arg);
+    } else {
+      options.inputs.push_back(arg);
+    }
+  }
+  if (options.inputs.empty()) options.inputs.push_back("input.v");
+  if (options.stream && options.parallel_parse) {
+    fail_usage("--stream cannot be combined with --parallel-parse");
+  }
+  if (options.stream && !options.passes.empty()) {
+    fail_usage("--stream cannot be combined with --pass");
+  }
+  if (options.stream && !options.output_dir.empty()) {
+    fail_usage("--stream cannot be combined with --output-dir");
+  }
+  if (options.shards > 0 && options.output_dir.empty()) {
+    fail_usage("--shards requires --output-dir");
+  }
+  if (options.build && options.output_dir.empty()) {
+    fail_usage("--build requires --output-dir");
+  }
+  if (options.shards == 0) options.shards = 1;
+  if (options.cc.empty()) {
+    const char* cc = std::getenv("CC");
+    options.cc = cc && *cc ? cc : "cc";
+  }
+  return options;
+}
+
+/*
+  Prints all diagnostics to standard error, and exits if any of them are errors,
+  since the graph is then incomplete
+*/
+void check_diagnostics(const Diagnostics& diagnostics) {
+  for (const Diagnostic& diagnostic : diagnostics.entries()) {
+    std::cerr << diagnostic << "\n";
+  }
+  if (diagnostics.has_errors()) std::exit(EXIT_FAILURE);
+}
+
 // Prints the tokens to standard output, one per line
 void print_tokens(const std::vector<Token> tokens) {
   for (const Token token : tokens) {
@@ -41,33 +229,306 @@ void print_tokens(const std::vector<Token> tokens) {
   }
 }
 
-// Reads the file, returning the contents in a null-terminated string
-std::string read_file(const std::string& file_name) {
-  std::ifstream ifs{file_name};
-  std::stringstream ss{};
-  ss << ifs.rdbuf() << '\0';
-  return ss.str();
+/*
+  Source files of the main package, expanding directories into their source
+  files
+*/
+std::vector<std::string> find_input_files(const Options& options) {
+  std::vector<std::string> files;
+  for (const std::string& input : options.inputs) {
+    if (std::filesystem::is_directory(input)) {
+      for (std::string& file : ModuleLoader::package_files(input)) {
+        files.push_back(std::move(file));
+      }
+    } else {
+      files.push_back(input);
+    }
+  }
+  return files;
+}
+
+/*
+  Unless import paths are given, imported packages are searched for next to
+  the first input, which is either a file or the directory of the main package
+*/
+std::vector<std::string> find_import_paths(const Options& options) {
+  if (!options.import_paths.empty()) return options.import_paths;
+  std::filesystem::path input =
+    std::filesystem::path{options.inputs.front()}.lexically_normal();
+  if (!input.has_filename()) input = input.parent_path();
+  std::filesystem::path import_path = input.parent_path();
+  return {import_path.empty() ? "." : import_path.string()};
+}
+
+// Writes the interface of the package to the interface directory
+void write_interface(
+  const Options& options, const std::shared_ptr<Package>& package)
+{
+  std::error_code error;
+  std::filesystem::create_directories(options.interface_dir, error);
+  std::string path = (std::filesystem::path{options.interface_dir} /
+    (package->name() + interface_extension)).string();
+  if (write_file_if_changed(path, print_interface(package)) ==
+    WriteResult::failed)
+  {
+    fail_usage("cannot write " + path);
+  }
+}
+
+// Writes a file of the C code to the output directory
+void write_output(const Options& options, const std::string& name,
+  const std::string& code)
+{
+  std::string path =
+    (std::filesystem::path{options.output_dir} / name).string();
+  if (write_file_if_changed(path, code) == WriteResult::failed) {
+    fail_usage("cannot write " + path);
+  }
+}
+
+// Path of a file of the C code in the output directory
+std::string output_path(const Options& options, const std::string& name) {
+  return (std::filesystem::path{options.output_dir} / name).string();
+}
+
+// Name of the source file of the given shard of the package
+std::string shard_name(const std::string& package, std::size_t shard) {
+  return package + "_" + std::to_string(shard) + ".c";
+}
+
+/*
+  Translates the packages into a header and source files in the output
+  directory, returning their paths. The imported packages, which are compiled
+  separately, are only declared in the header. Files whose code did not change
+  are left untouched, so that build tools only recompile the changed shards.
+  Shards left over from an earlier run with more shards are removed.
+*/
+CSources write_shards(const Options& options, const std::string& name,
+  const std::vector<std::shared_ptr<Package>>& packages,
+  const std::vector<std::shared_ptr<Package>>& imported,
+  ThreadPool& thread_pool, TranslationCache* cache)
+{
+  std::error_code error;
+  std::filesystem::create_directories(options.output_dir, error);
+  std::string header_name = name + ".h";
+  ShardedCode code{translate(packages, imported, options.shards, header_name,
+    thread_pool, cache)};
+  write_output(options, header_name, code.header);
+  CSources sources{output_path(options, header_name), {}};
+  for (std::size_t i = 0; i < code.shards.size(); ++i) {
+    write_output(options, shard_name(name, i), code.shards[i]);
+    sources.sources.push_back(output_path(options, shard_name(name, i)));
+  }
+  for (std::size_t i = code.shards.size(); ; ++i) {
+    if (!std::filesystem::remove(
+      output_path(options, shard_name(name, i)), error))
+    {
+      break;
+    }
+  }
+  return sources;
+}
+
+/*
+  Finds the header and source files that an earlier run wrote to the output
+  directory for the package, which was compiled separately
+*/
+CSources find_shards(const Options& options, const std::string& name) {
+  CSources sources{output_path(options, name + ".h"), {}};
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(sources.header, error)) {
+    fail_usage("cannot find the C code of package \"" + name + "\" in " +
+      options.output_dir);
+  }
+  for (std::size_t i = 0; ; ++i) {
+    std::string source = output_path(options, shard_name(name, i));
+    if (!std::filesystem::is_regular_file(source, error)) break;
+    sources.sources.push_back(source);
+  }
+  return sources;
+}
+
+/*
+  Compiles the source files written to the output directory, with those of
+  the imported packages, into the executable, printing how many objects were
+  cached
+*/
+void build(const Options& options, const std::string& name,
+  const CSources& sources,
+  const std::vector<std::shared_ptr<Package>>& imported, std::size_t jobs)
+{
+  CCompiler compiler{options.cc, split_flags(options.cflags),
+    split_flags(options.ldflags), jobs};
+  std::vector<CSources> code{sources};
+  for (const auto& package : imported) {
+    code.push_back(find_shards(options, package->name()));
+  }
+  std::filesystem::path output_dir{options.output_dir};
+  std::string object_dir = options.cache_dir.empty() ?
+    (output_dir / "objects").string() : options.cache_dir;
+  std::string executable = (output_dir / name).string();
+  bool built = compiler.build(code, object_dir, executable);
+  std::cerr << "object cache: " << compiler.hits() << " hits, " <<
+    compiler.misses() << " misses\n";
+  if (!built) fail_usage("cannot build " + executable);
+}
+
+/*
+  Translates the packages into C code one function at a time, with imported
+  packages first. Function bodies are parsed in order on this thread, and
+  passed to a translator thread, which writes each function's code and then
+  releases its body. Only the declarations and the few function bodies in
+  flight are in memory at once. Errors in a body are only found once the code
+  before it has been written. Since the prototypes of each package are written
+  first, functions are defined in declaration order. Packages loaded from
+  interfaces are only declared.
+*/
+void stream(const ModuleLoader& loader,
+  const std::vector<std::shared_ptr<Package>>& packages,
+  TranslationCache* cache)
+{
+  /*
+    Packages, whose declarations are translated first, and then their
+    functions to translate, in order, ending with nullptr
+  */
+  SpscRing<std::shared_ptr<Entity>> entities{64};
+  bool written = true;
+  std::thread translator_thread{[&entities, &written, cache] {
+    OutputBuffer code;
+    while (std::shared_ptr<Entity> entity = entities.pop()) {
+      if (auto package = std::dynamic_pointer_cast<Package>(entity)) {
+        translate_declarations(package, code);
+      } else if (auto function = std::dynamic_pointer_cast<Function>(entity)) {
+        translate(function, code, cache);
+        function->release_body();
+      }
+      if (code.size() >= output_flush_size) {
+        written &= code.flush(STDOUT_FILENO);
+      }
+    }
+    written &= code.flush(STDOUT_FILENO);
+  }};
+  for (const auto& package : packages) {
+    entities.push(package);
+    if (loader.from_interface(package)) continue;
+    for (const auto& function : package->function_entities()) {
+      function->load_body();
+      entities.push(function);
+    }
+  }
+  entities.push(nullptr);
+  translator_thread.join();
+  if (!written) fail_usage("cannot write the C code");
+}
+
+// Prints how many functions were translated, and how many were cached
+void print_cache_statistics(const TranslationCache* cache) {
+  if (!cache) return;
+  std::cerr << "translation cache: " << cache->hits() << " hits, " <<
+    cache->misses() << " misses\n";
 }
 
-int main() {
-  // Read source file
-  std::string source_code = read_file("input.v");
-  std::cout << "----------V Code----------\n";
-  std::cout << source_code << "\n";
+int main(int argc, char* argv[]) {
+  Options options{parse_options(argc, argv)};
+  ThreadPool thread_pool{options.jobs};
+  std::shared_ptr<Diagnostics> diagnostics{std::make_shared<Diagnostics>()};
+  ModuleLoader loader{thread_pool, diagnostics};
+  std::unique_ptr<TranslationCache> cache;
+  if (!options.cache_dir.empty()) {
+    cache = std::make_unique<TranslationCache>(options.cache_dir);
+  }
+  for (const std::string& import_path : find_import_paths(options)) {
+    loader.add_import_path(import_path);
+  }
+  loader.set_interface_dir(options.interface_dir);
+  loader.set_lazy_bodies(options.lazy || options.stream);
+  loader.set_parallel_bodies(options.parallel_parse);
+  loader.set_pipelined(options.stream);
+
+  // Read and lex source files into lists of tokens
+  std::vector<SourceFile> files{loader.read_files(find_input_files(options))};
+  if (diagnostics->has_errors()) check_diagnostics(*diagnostics);
+  for (const SourceFile& file : files) {
+    if (options.stream) break;
+    std::cout << "----------V Code----------\n";
+    std::cout << file.source << "\n";
+    std::cout << "----------Tokens----------\n";
+    print_tokens(file.tokens);
+  }
 
-  // Run lexer on source code to get a list of tokens
-  std::shared_ptr<Lexer> lexer{std::make_shared<Lexer>(std::move(source_code))};
-  std::vector<Token> tokens{lexer->run()};
-  std::cout << "----------Tokens----------\n";
-  print_tokens(tokens);
+  // Parse the main package, and the packages it imports, into graphs
+  std::shared_ptr<Package> package{loader.load(std::move(files))};
+  if (diagnostics->has_errors()) check_diagnostics(*diagnostics);
+  std::vector<std::shared_ptr<Package>> packages{loader.packages()};
+  if (options.stream) {
+    stream(loader, packages, cache.get());
+    print_cache_statistics(cache.get());
+    check_diagnostics(*diagnostics);
+    if (!options.interface_dir.empty()) write_interface(options, package);
+    return EXIT_SUCCESS;
+  }
+
+  // Run the requested passes over the graph
+  for (const std::string& plugin : options.plugins) {
+    if (!PassRegistry::instance().load_plugin(plugin)) {
+      fail_usage("cannot load plugin " + plugin);
+    }
+  }
+  PassManager pass_manager{thread_pool};
+  for (const std::string& name : options.passes) {
+    std::shared_ptr<Pass> pass = PassRegistry::instance().create(name);
+    if (!pass) fail_usage("unknown pass " + name);
+    pass_manager.add(pass);
+  }
+  pass_manager.run(package);
+  if (options.time_passes) {
+    std::cout << "----------Passes----------\n";
+    std::cout << print(pass_manager.timings());
+  }
 
-  // Run parser on list of tokens to build graph
-  std::shared_ptr<Parser> parser{std::make_shared<Parser>(std::move(tokens))};
-  std::shared_ptr<Package> package{parser->run()};
   std::cout << "----------Graph ----------\n";
-  std::cout << print(package);
+  for (const auto& loaded : packages) {
+    std::cout << (options.summary ? print_summary(loaded) : print(loaded));
+  }
+
+  // The graph is only read from here on
+  for (const auto& loaded : packages) {
+    loaded->freeze();
+  }
+  check_diagnostics(*diagnostics);
 
-  // Translate graph into C code
-  std::cout << "----------C Code----------\n";
-  std::cout << translate(package);
+  // Write the interface for separately compiling the packages importing this
+  if (!options.interface_dir.empty()) write_interface(options, package);
+
+  /*
+    Translate graph into C code, with imported packages first, translating the
+    functions of each package in parallel. Packages loaded from interfaces are
+    compiled separately, so they are only declared.
+  */
+  std::vector<std::shared_ptr<Package>> translated;
+  std::vector<std::shared_ptr<Package>> imported;
+  for (const auto& loaded : packages) {
+    (loader.from_interface(loaded) ? imported : translated).push_back(loaded);
+  }
+  if (!options.output_dir.empty()) {
+    CSources sources{write_shards(options, package->name(), translated,
+      imported, thread_pool, cache.get())};
+    print_cache_statistics(cache.get());
+    if (options.build) {
+      build(options, package->name(), sources, imported,
+        thread_pool.thread_count());
+    }
+    return EXIT_SUCCESS;
+  }
+  std::cout << "----------C Code----------\n" << std::flush;
+  OutputBuffer code;
+  for (const auto& loaded : packages) {
+    if (loader.from_interface(loaded)) {
+      translate_declarations(loaded, code);
+    } else {
+      translate(loaded, code, thread_pool, cache.get());
+    }
+  }
+  if (!code.flush(STDOUT_FILENO)) fail_usage("cannot write the C code");
+  print_cache_statistics(cache.get());
 }
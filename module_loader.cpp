@@ -0,0 +1,428 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "module_loader.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include "interface.h"
+#include "lexer.h"
+
+namespace {
+
+// Number of tokens in each batch passed from the lexer to a parser
+constexpr std::size_t token_batch_size = 4096;
+// Number of batches the lexer may be ahead of a parser
+constexpr std::size_t token_ring_capacity = 64;
+
+}  // namespace
+
+ModuleLoader::ModuleLoader(
+  ThreadPool& thread_pool, std::shared_ptr<Diagnostics> diagnostics):
+  thread_pool_{thread_pool},
+  diagnostics_{std::move(diagnostics)},
+  lazy_bodies_{false},
+  parallel_bodies_{false},
+  pipelined_{false}
+{}
+
+std::vector<std::string> ModuleLoader::package_files(
+  const std::string& directory)
+{
+  std::vector<std::string> files;
+  std::error_code error;
+  for (const auto& entry :
+    std::filesystem::directory_iterator{directory, error})
+  {
+    if (entry.is_regular_file(error) && entry.path().extension() == ".v") {
+      files.push_back(entry.path().string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::vector<SourceFile> ModuleLoader::read_files(
+  const std::vector<std::string>& names)
+{
+  std::vector<SourceFile> files(names.size());
+  std::vector<char> read(names.size());
+  thread_pool_.parallel_for(names.size(), [&](std::size_t i) {
+    std::ifstream ifs{names[i]};
+    if (!ifs) {
+      diagnostics_->report(
+        Diagnostic{Severity::error, names[i], 0, 0, "cannot read file"});
+      return;
+    }
+    std::stringstream ss{};
+    ss << ifs.rdbuf() << '\0';
+    files[i].name = names[i];
+    files[i].source = ss.str();
+    if (!pipelined_) files[i].tokens = Lexer{files[i].source}.run();
+    read[i] = true;
+  });
+
+  std::vector<SourceFile> read_files;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (read[i]) read_files.push_back(std::move(files[i]));
+  }
+  return read_files;
+}
+
+/*
+  The import graph is found first, declaring the packages first imported at
+  each depth in parallel. Then each package is defined by a task of its own,
+  submitted once the packages it imports are defined, so that no task waits
+  for another package. Waiting on a package from a task could deadlock the
+  pool, since a waiting thread runs other tasks on its own stack, including
+  tasks that wait for the package it is suspended in the middle of loading.
+*/
+std::shared_ptr<Package> ModuleLoader::load(std::vector<SourceFile> files) {
+  std::unique_ptr<Unit> main =
+    declare("default", std::move(files), true, false);
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (modules_.count(main->name)) {
+      diagnostics_->report(Diagnostic{Severity::error, "", 0, 0,
+        "package \"" + main->name + "\" is already loaded"});
+      return nullptr;
+    }
+  }
+  std::shared_ptr<Package> package = main->package;
+
+  // Packages loaded by earlier calls are reused rather than declared again
+  std::vector<std::unique_ptr<Unit>> units;
+  std::map<std::string, Unit*> declared{{main->name, main.get()}};
+  units.push_back(std::move(main));
+  std::vector<Unit*> frontier{units.front().get()};
+  while (!frontier.empty()) {
+    std::vector<std::string> names;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      for (Unit* unit : frontier) {
+        for (const std::string& name : unit->imports) {
+          if (!modules_.count(name) && declared.emplace(name, nullptr).second)
+          {
+            names.push_back(name);
+          }
+        }
+      }
+    }
+    std::vector<std::unique_ptr<Unit>> imported(names.size());
+    thread_pool_.parallel_for(names.size(), [&](std::size_t i) {
+      imported[i] = declare_import(names[i]);
+    });
+    frontier.clear();
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      if (!imported[i]) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        modules_.emplace(names[i], nullptr);
+        continue;
+      }
+      declared[names[i]] = imported[i].get();
+      frontier.push_back(imported[i].get());
+      units.push_back(std::move(imported[i]));
+    }
+  }
+
+  // Each unit waits for the units it imports, other than through cycles
+  for (const auto& unit : units) {
+    find_cycles(*unit);
+    unit->waiting = 0;
+    for (const std::string& name : unit->imports) {
+      auto dependency = declared.find(name);
+      if (unit->cyclic.count(name) || dependency == declared.cend() ||
+        !dependency->second)
+      {
+        continue;
+      }
+      dependency->second->dependents.push_back(unit.get());
+      ++unit->waiting;
+    }
+  }
+
+  std::mutex schedule_mutex;
+  std::exception_ptr exception;
+  std::atomic<std::size_t> remaining{units.size()};
+  std::function<void(Unit*)> schedule = [&](Unit* unit) {
+    thread_pool_.submit([&, unit] {
+      try {
+        define(*unit);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{schedule_mutex};
+        if (!exception) exception = std::current_exception();
+      }
+      std::vector<Unit*> ready;
+      {
+        std::lock_guard<std::mutex> lock{schedule_mutex};
+        for (Unit* dependent : unit->dependents) {
+          if (--dependent->waiting == 0) ready.push_back(dependent);
+        }
+      }
+      for (Unit* dependent : ready) schedule(dependent);
+      --remaining;
+    });
+  };
+  for (const auto& unit : units) {
+    if (unit->waiting == 0) schedule(unit.get());
+  }
+  thread_pool_.wait_until([&] { return remaining == 0; });
+  if (exception) std::rethrow_exception(exception);
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  roots_.push_back(package->name());
+  return package;
+}
+
+std::vector<std::shared_ptr<Package>> ModuleLoader::packages() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::vector<std::shared_ptr<Package>> packages;
+  std::set<std::string> visited;
+  // Visits the imports of a package, in sorted order, before the package
+  std::function<void(const std::string&)> visit =
+    [&](const std::string& name) {
+      if (!visited.insert(name).second) return;
+      auto imports = imports_.find(name);
+      if (imports != imports_.cend()) {
+        for (const std::string& imported : imports->second) visit(imported);
+      }
+      auto loaded = loaded_.find(name);
+      if (loaded != loaded_.cend()) packages.push_back(loaded->second);
+    };
+  for (const std::string& root : roots_) visit(root);
+  return packages;
+}
+
+bool ModuleLoader::from_interface(
+  const std::shared_ptr<Package>& package) const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return interfaces_.count(package.get()) > 0;
+}
+
+/*
+  Declares the package with the given name, from its interface or else its
+  sources. Returns nullptr if the package cannot be found.
+*/
+std::unique_ptr<ModuleLoader::Unit> ModuleLoader::declare_import(
+  const std::string& name)
+{
+  std::string interface;
+  if (!interface_dir_.empty()) {
+    interface = (std::filesystem::path{interface_dir_} /
+      (name + interface_extension)).lexically_normal().string();
+  }
+  std::error_code error;
+  if (!interface.empty() &&
+    std::filesystem::is_regular_file(interface, error))
+  {
+    return declare(name, read_files({interface}), false, true);
+  }
+  std::vector<std::string> file_names = find_files(name);
+  if (file_names.empty()) return nullptr;
+  return declare(name, read_files(file_names), false, false);
+}
+
+/*
+  Declares the files one at a time, finding the name of the package and the
+  packages it imports, which are recorded in the import graph
+*/
+std::unique_ptr<ModuleLoader::Unit> ModuleLoader::declare(
+  std::string name, std::vector<SourceFile> files, bool main, bool interface)
+{
+  auto unit = std::make_unique<Unit>();
+  unit->interface = interface;
+  unit->declarations = std::make_shared<SymbolTable>();
+  unit->package = Parser::create_package(name, *unit->declarations);
+  std::vector<std::shared_ptr<TokenRing>> token_rings;
+  std::thread lexer_thread;
+  if (pipelined_) {
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      token_rings.push_back(std::make_shared<TokenRing>(token_ring_capacity));
+    }
+    // Lexes the files in the order they are declared in
+    lexer_thread = std::thread{[&files, token_rings] {
+      for (std::size_t i = 0; i < files.size(); ++i) {
+        std::shared_ptr<TokenRing> token_ring = token_rings[i];
+        Lexer{std::move(files[i].source)}.run(
+          [&](std::vector<Token> batch) { token_ring->push(std::move(batch)); },
+          token_batch_size);
+      }
+    }};
+  }
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    SourceFile& file = files[i];
+    auto parser = pipelined_ ? std::make_unique<Parser>(token_rings[i]) :
+      std::make_unique<Parser>(std::move(file.tokens));
+    parser->set_file_name(file.name);
+    parser->set_diagnostics(diagnostics_);
+    parser->set_package(unit->package, unit->declarations);
+    parser->set_interface(interface);
+    parser->declare();
+    unit->file_names.push_back(file.name);
+    unit->parsers.push_back(std::move(parser));
+  }
+  if (lexer_thread.joinable()) lexer_thread.join();
+
+  /*
+    The main package is named by its package declarations, while an imported
+    package must declare the name it was imported by, if any.
+  */
+  bool named = false;
+  for (std::size_t i = 0; i < unit->parsers.size(); ++i) {
+    const std::optional<Token>& package_name =
+      unit->parsers[i]->package_name();
+    if (!package_name) continue;
+    if (main && !named) {
+      name = package_name->lexeme;
+      unit->package->set_name(name);
+    } else if (package_name->lexeme != name) {
+      error(*package_name, unit->file_names[i], "package \"" +
+        package_name->lexeme + "\" does not match package \"" + name + "\"");
+    }
+    named = true;
+  }
+  unit->name = std::move(name);
+
+  for (const auto& parser : unit->parsers) {
+    for (const Parser::Import& import : parser->imports()) {
+      unit->imports.insert(import.package.lexeme);
+    }
+  }
+  std::lock_guard<std::mutex> lock{mutex_};
+  imports_[unit->name] = unit->imports;
+  return unit;
+}
+
+/*
+  Finds the imports of the unit that are part of an import cycle, once the
+  whole import graph is known, and reports them
+*/
+void ModuleLoader::find_cycles(Unit& unit) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (const std::string& name : unit.imports) {
+      if (imports(name, unit.name)) unit.cyclic.insert(name);
+    }
+  }
+  for (std::size_t i = 0; i < unit.parsers.size(); ++i) {
+    for (const Parser::Import& import : unit.parsers[i]->imports()) {
+      if (unit.cyclic.count(import.package.lexeme)) {
+        error(import.package, unit.file_names[i],
+          "import cycle between package \"" + unit.name +
+          "\" and package \"" + import.package.lexeme + "\"");
+      }
+    }
+  }
+}
+
+/*
+  Defines the files of the unit and parses its function bodies, in parallel,
+  once the packages it imports are loaded
+*/
+void ModuleLoader::define(Unit& unit) {
+  std::map<std::string, std::shared_ptr<const SymbolTable>> resolved;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (const std::string& name : unit.imports) {
+      auto module = modules_.find(name);
+      if (unit.cyclic.count(name) || module == modules_.cend() ||
+        !module->second)
+      {
+        continue;
+      }
+      resolved.emplace(name, module->second->declarations);
+    }
+  }
+
+  thread_pool_.parallel_for(unit.parsers.size(), [&](std::size_t i) {
+    unit.parsers[i]->set_import_resolver(
+      [&](const std::string& package_name) {
+        auto iterator = resolved.find(package_name);
+        return iterator == resolved.cend() ? nullptr : iterator->second;
+      });
+    unit.parsers[i]->define();
+  });
+  std::vector<std::shared_ptr<Function>> functions;
+  for (const auto& parser : unit.parsers) {
+    functions.insert(functions.end(), parser->functions().cbegin(),
+      parser->functions().cend());
+  }
+  if (parallel_bodies_) {
+    thread_pool_.parallel_for(functions.size(), [&](std::size_t i) {
+      functions[i]->load_body();
+    });
+  } else if (!lazy_bodies_) {
+    for (const auto& function : functions) {
+      function->load_body();
+    }
+  }
+
+  auto module = std::make_shared<const Module>(
+    Module{unit.package, unit.declarations});
+  std::lock_guard<std::mutex> lock{mutex_};
+  modules_.emplace(unit.name, module);
+  loaded_.emplace(unit.name, unit.package);
+  if (unit.interface) interfaces_.insert(unit.package.get());
+}
+
+/*
+  Source files of the package with the given name, from the first import path
+  that has any
+*/
+std::vector<std::string> ModuleLoader::find_files(
+  const std::string& name) const
+{
+  for (const std::string& import_path : import_paths_) {
+    std::vector<std::string> files =
+      package_files((std::filesystem::path{import_path} / name)
+        .lexically_normal().string());
+    if (!files.empty()) return files;
+  }
+  return {};
+}
+
+// Whether package from imports package to, directly or indirectly
+bool ModuleLoader::imports(const std::string& from, const std::string& to) const
+{
+  std::set<std::string> visited{from};
+  std::vector<std::string> stack{from};
+  while (!stack.empty()) {
+    std::string name = std::move(stack.back());
+    stack.pop_back();
+    if (name == to) return true;
+    auto edges = imports_.find(name);
+    if (edges == imports_.cend()) continue;
+    for (const std::string& edge : edges->second) {
+      if (visited.insert(edge).second) stack.push_back(edge);
+    }
+  }
+  return false;
+}
+
+// Reports an error at a token of the given file
+void ModuleLoader::error(const Token& token, const std::string& file_name,
+  const std::string& message)
+{
+  diagnostics_->report(Diagnostic{Severity::error, file_name,
+    token.line_number, token.column_number, message});
+}
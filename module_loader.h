@@ -0,0 +1,200 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  The module loader turns the files of a package, and the packages it imports,
+  into program graphs. Each package is a directory of ".v" source files, found
+  by its name in a list of import paths, and its files may declare the package
+  name with "package NAME;". Files import entities from other packages with
+  "import PACKAGE.NAME;".
+
+  Packages are loaded on a thread pool, in two phases:
+    - The import graph is found first. The files of each package are read,
+      lexed, and declared, which is a quick scan over their tokens that finds
+      their imports. The newly imported packages at each depth of the graph
+      are declared in parallel with each other.
+    - Each package is then defined, and has its function bodies parsed, as a
+      task of its own, submitted once all of the packages it imports are
+      defined. The files and bodies of a package are parsed in parallel.
+  Tasks never wait for other packages, only for their own parallel work, so
+  the pool cannot deadlock however the imports are shaped. The time to load a
+  graph of packages is limited by its longest chain of imports rather than by
+  its total size. Each package is loaded at most once, however many packages
+  import it, and is kept for the rest of the compilation. Import cycles are
+  reported as errors, and their imports left unresolved.
+
+  If pipelined, the files of a package are instead lexed on a separate thread
+  while they are being declared, each passing its tokens to its parser in
+  batches.
+
+  If an interface directory is set, an imported package whose interface is
+  found there (see interface.h) is loaded from the interface instead of its
+  sources. Interfaces are trusted to be up to date, so the build must compile
+  a package, writing its interface, before the packages that import it.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "diagnostics.h"
+#include "graph.h"
+#include "parser.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+#include "token.h"
+
+// A source file, along with its tokens, unless the loader is pipelined
+struct SourceFile {
+  std::string name;
+  std::string source;
+  std::vector<Token> tokens;
+};
+
+// Loads packages from source files, along with the packages they import
+class ModuleLoader {
+public:
+  // Errors are reported to diagnostics, and work runs on thread_pool
+  ModuleLoader(
+    ThreadPool& thread_pool, std::shared_ptr<Diagnostics> diagnostics);
+
+  /*
+    Adds a directory that packages are searched for in, each package being a
+    subdirectory. Directories are searched in the order they were added.
+  */
+  void add_import_path(std::string import_path) {
+    import_paths_.push_back(std::move(import_path));
+  }
+
+  /*
+    Sets the directory that the interfaces of imported packages are loaded
+    from, if present. Defaults to none, in which case packages are always
+    loaded from their sources.
+  */
+  void set_interface_dir(std::string interface_dir) {
+    interface_dir_ = std::move(interface_dir);
+  }
+
+  // Sets whether function bodies are parsed lazily (see Parser)
+  void set_lazy_bodies(bool lazy_bodies) { lazy_bodies_ = lazy_bodies; }
+
+  /*
+    Sets whether the function bodies of each package are parsed in parallel.
+    Otherwise, they are parsed in order of definition, unless parsed lazily.
+  */
+  void set_parallel_bodies(bool parallel_bodies) {
+    parallel_bodies_ = parallel_bodies;
+  }
+
+  /*
+    Sets whether the files of each package are lexed on a separate thread while
+    they are declared, rather than up front by read_files(), which then leaves
+    the tokens empty. Defaults to false.
+  */
+  void set_pipelined(bool pipelined) { pipelined_ = pipelined; }
+
+  // Source files of the package in directory, in sorted order
+  static std::vector<std::string> package_files(const std::string& directory);
+
+  /*
+    Reads and lexes the files, in parallel. Files that cannot be read are
+    reported, and left out. Pipelined loaders do not lex the files.
+  */
+  std::vector<SourceFile> read_files(const std::vector<std::string>& names);
+
+  /*
+    Parses the files into the main package of the compilation, loading the
+    packages it imports. The package is named by the package declarations of
+    the files, or "default" if there are none. Returns nullptr if the package
+    has the name of a package that was already loaded. Must not be called from
+    a task of the thread pool.
+  */
+  std::shared_ptr<Package> load(std::vector<SourceFile> files);
+
+  /*
+    Loaded packages, each after the packages it imports, in an order that only
+    depends on the import graph.
+  */
+  std::vector<std::shared_ptr<Package>> packages() const;
+
+  /*
+    Whether the package was loaded from its interface, in which case its
+    functions have no bodies, and are compiled separately.
+  */
+  bool from_interface(const std::shared_ptr<Package>& package) const;
+
+private:
+  // A loaded package, along with the index of names it declares
+  struct Module {
+    std::shared_ptr<Package> package;
+    std::shared_ptr<const SymbolTable> declarations;
+  };
+
+  // A package whose files are declared, but not yet defined
+  struct Unit {
+    std::string name;
+    bool interface;
+    std::shared_ptr<Package> package;
+    std::shared_ptr<SymbolTable> declarations;
+    // Names of the files, for diagnostics, and their parsers
+    std::vector<std::string> file_names;
+    std::vector<std::unique_ptr<Parser>> parsers;
+    // Names of the packages imported by the files
+    std::set<std::string> imports;
+    // Imports that are part of an import cycle, which are left unresolved
+    std::set<std::string> cyclic;
+    // Number of imported packages that are not defined yet
+    std::size_t waiting;
+    // Units importing this unit
+    std::vector<Unit*> dependents;
+  };
+
+  std::unique_ptr<Unit> declare_import(const std::string& name);
+  std::unique_ptr<Unit> declare(std::string name,
+    std::vector<SourceFile> files, bool main, bool interface);
+  void find_cycles(Unit& unit);
+  void define(Unit& unit);
+  std::vector<std::string> find_files(const std::string& name) const;
+  bool imports(const std::string& from, const std::string& to) const;
+  void error(const Token& token, const std::string& file_name,
+    const std::string& message);
+
+  ThreadPool& thread_pool_;
+  std::shared_ptr<Diagnostics> diagnostics_;
+  std::vector<std::string> import_paths_;
+  std::string interface_dir_;
+  bool lazy_bodies_;
+  bool parallel_bodies_;
+  bool pipelined_;
+
+  // Guards all of the following
+  mutable std::mutex mutex_;
+  // Packages that finished loading, and the packages that were not found
+  std::map<std::string, std::shared_ptr<const Module>> modules_;
+  // Names of the packages imported by each package whose imports are known
+  std::map<std::string, std::set<std::string>> imports_;
+  // Packages that finished loading, by name
+  std::map<std::string, std::shared_ptr<Package>> loaded_;
+  // Packages that were loaded from their interfaces
+  std::set<const Package*> interfaces_;
+  // Names of the packages loaded by load(), in order
+  std::vector<std::string> roots_;
+};
@@ -0,0 +1,101 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "output_buffer.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sys/uio.h>
+
+void OutputBuffer::append(std::string_view text) {
+  while (!text.empty()) {
+    if (position_ == end_) next_chunk();
+    std::size_t size =
+      std::min(text.size(), static_cast<std::size_t>(end_ - position_));
+    std::memcpy(position_, text.data(), size);
+    position_ += size;
+    text.remove_prefix(size);
+  }
+}
+
+void OutputBuffer::append(const OutputBuffer& other) {
+  for (std::size_t i = 0; other.position_ && i <= other.chunk_; ++i) {
+    const char* chunk = other.chunks_[i].get();
+    append(std::string_view{
+      chunk, i == other.chunk_ ? other.position_ - chunk : chunk_size});
+  }
+}
+
+std::string OutputBuffer::str(std::size_t begin) const {
+  std::string code;
+  if (begin >= size()) return code;
+  code.reserve(size() - begin);
+  for (std::size_t i = begin / chunk_size; i <= chunk_; ++i) {
+    const char* chunk = chunks_[i].get();
+    std::size_t start = i == begin / chunk_size ? begin % chunk_size : 0;
+    std::size_t end = i == chunk_ ? position_ - chunk : chunk_size;
+    code.append(chunk + start, end - start);
+  }
+  return code;
+}
+
+/*
+  Writes the chunks with as few writev calls as possible, continuing after
+  partial writes and interruptions
+*/
+bool OutputBuffer::flush(int fd) {
+  std::vector<iovec> iovecs;
+  for (std::size_t i = 0; position_ && i <= chunk_; ++i) {
+    char* chunk = chunks_[i].get();
+    std::size_t size = i == chunk_ ?
+      static_cast<std::size_t>(position_ - chunk) : chunk_size;
+    iovecs.push_back(iovec{chunk, size});
+  }
+  clear();
+
+  std::size_t first = 0;
+  while (first < iovecs.size()) {
+    int count = static_cast<int>(std::min<std::size_t>(
+      iovecs.size() - first, IOV_MAX));
+    ssize_t written = writev(fd, &iovecs[first], count);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    // Skip what was written, which may end partway through a chunk
+    std::size_t remaining = static_cast<std::size_t>(written);
+    while (first < iovecs.size() && remaining >= iovecs[first].iov_len) {
+      remaining -= iovecs[first++].iov_len;
+    }
+    if (remaining > 0) {
+      iovecs[first].iov_base = static_cast<char*>(iovecs[first].iov_base) +
+        remaining;
+      iovecs[first].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+// Moves on to the next chunk, allocating it if no chunk is left for reuse
+void OutputBuffer::next_chunk() {
+  if (position_) ++chunk_;
+  if (chunk_ == chunks_.size()) {
+    chunks_.emplace_back(new char[chunk_size]);
+  }
+  position_ = chunks_[chunk_].get();
+  end_ = position_ + chunk_size;
+}
@@ -0,0 +1,105 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  A growable buffer that the translator writes C code into. The buffer is made
+  of fixed size chunks, so appending never moves the code already written, and
+  clearing the buffer keeps the chunks for reuse. Once the buffer is warm,
+  translating a function allocates nothing, however many entities it has.
+
+  The chunks are written to a file descriptor with a single writev call, rather
+  than being copied into one string first.
+*/
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Collects output in chunks, to be written to a file descriptor or a string
+class OutputBuffer {
+public:
+  OutputBuffer() = default;
+
+  // Not copyable or assignable
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  // Appends text to the end of the buffer
+  void append(std::string_view text);
+  void append(char c) {
+    if (position_ == end_) next_chunk();
+    *position_++ = c;
+  }
+
+  // Appends the contents of another buffer
+  void append(const OutputBuffer& other);
+
+  OutputBuffer& operator<<(std::string_view text) {
+    append(text);
+    return *this;
+  }
+  OutputBuffer& operator<<(char c) {
+    append(c);
+    return *this;
+  }
+  OutputBuffer& operator<<(std::int64_t value) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    append(std::string_view{digits, static_cast<std::size_t>(end - digits)});
+    return *this;
+  }
+
+  // Number of characters in the buffer
+  std::size_t size() const {
+    if (!position_) return 0;
+    return chunk_ * chunk_size + (position_ - chunks_[chunk_].get());
+  }
+
+  // Empties the buffer, keeping its chunks for reuse
+  void clear() {
+    chunk_ = 0;
+    position_ = nullptr;
+    end_ = nullptr;
+  }
+
+  // Contents of the buffer, starting at index begin
+  std::string str(std::size_t begin = 0) const;
+
+  /*
+    Writes the contents of the buffer to the file descriptor, and empties the
+    buffer. Returns whether all of the contents were written.
+  */
+  bool flush(int fd);
+
+private:
+  static constexpr std::size_t chunk_size = 64 * 1024;
+
+  void next_chunk();
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  // Index of the chunk being appended to
+  std::size_t chunk_ = 0;
+  // Where the next character goes in that chunk, and the end of the chunk,
+  // or nullptr if the buffer is empty
+  char* position_ = nullptr;
+  char* end_ = nullptr;
+};
@@ -15,16 +15,26 @@
 */
 
 #include "parser.h"
-#include <cstdlib>
-#include <iostream>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <system_error>
 #include <utility>
 
 // Current state of the parser
 enum class ParserState {
-  // Inside an expression, expecting an operator
+  // Expecting the end of a class body
+  class_body_end,
+  // Expecting a class body
+  class_body_start,
+  // Expecting a class name
+  class_name,
+  // Inside an expression, expecting an operator, closing parenthesis, or end
   expression_operator,
-  // Inside an expression, expecting a value
+  // Inside an expression, expecting a value or opening parenthesis
   expression_value,
   // Expecting a function parameter list
   func_params_start,
@@ -32,7 +42,7 @@ enum class ParserState {
   func_name,
   // Expecting a function return clause or function body
   func_return_clause,
-  // Expecting a function body
+  // Expecting a function body, or a semicolon in package interfaces
   func_body,
   // Expecting a function parameter, starting with its class
   func_param,
@@ -50,57 +60,438 @@ enum class ParserState {
   statement,
 };
 
+/*
+  If the given token type is a binary operator, returns the corresponding
+  operator type. Otherwise, returns no value.
+*/
+std::optional<OperatorType> get_operator_type(TokenType token_type) {
+  switch (token_type) {
+    case TokenType::divide: return OperatorType::divide;
+    case TokenType::divide_equal: return OperatorType::divide_assign;
+    case TokenType::equal: return OperatorType::assign;
+    case TokenType::equal_equal: return OperatorType::equal;
+    case TokenType::greater: return OperatorType::greater;
+    case TokenType::greater_equal: return OperatorType::greater_equal;
+    case TokenType::less: return OperatorType::less;
+    case TokenType::less_equal: return OperatorType::less_equal;
+    case TokenType::minus: return OperatorType::minus;
+    case TokenType::minus_equal: return OperatorType::minus_assign;
+    case TokenType::modulo: return OperatorType::modulo;
+    case TokenType::modulo_equal: return OperatorType::modulo_assign;
+    case TokenType::multiply: return OperatorType::multiply;
+    case TokenType::multiply_equal: return OperatorType::multiply_assign;
+    case TokenType::not_equal: return OperatorType::not_equal;
+    case TokenType::plus: return OperatorType::plus;
+    case TokenType::plus_equal: return OperatorType::plus_assign;
+    default: return std::nullopt;
+  }
+}
+
+/*
+  Returns the precedence of the operator, with higher precedence operators
+  being applied first. Precedence follows C.
+*/
+int get_precedence(OperatorType operator_type) {
+  switch (operator_type) {
+    case OperatorType::divide:
+    case OperatorType::modulo:
+    case OperatorType::multiply:
+      return 4;
+    case OperatorType::minus:
+    case OperatorType::plus:
+      return 3;
+    case OperatorType::greater:
+    case OperatorType::greater_equal:
+    case OperatorType::less:
+    case OperatorType::less_equal:
+      return 2;
+    case OperatorType::equal:
+    case OperatorType::not_equal:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// Whether the entity may be imported by other packages
+bool is_public(const Entity& entity) {
+  if (auto function = dynamic_cast<const Function*>(&entity)) {
+    return function->is_public();
+  }
+  if (auto cls = dynamic_cast<const Class*>(&entity)) {
+    return cls->is_public();
+  }
+  return false;
+}
+
 Parser::Parser(std::vector<Token> tokens):
+  Parser{std::make_shared<const std::vector<Token>>(std::move(tokens)), 0}
+{}
+
+Parser::Parser(std::shared_ptr<TokenRing> token_ring):
+  Parser{std::make_shared<std::vector<Token>>(), 0}
+{
+  token_ring_ = std::move(token_ring);
+  received_tokens_ = std::const_pointer_cast<std::vector<Token>>(tokens_);
+}
+
+// Starts parsing at the token with index position
+Parser::Parser(
+  std::shared_ptr<const std::vector<Token>> tokens, std::size_t position):
   tokens_{std::move(tokens)},
-  iterator_{tokens_.cbegin()},
-  state_{ParserState::start}
+  diagnostics_{std::make_shared<Diagnostics>()},
+  iterator_{tokens_->cbegin() + position},
+  state_{ParserState::start},
+  lazy_bodies_{false},
+  thread_pool_{nullptr},
+  interface_{false},
+  body_only_{false},
+  next_declared_{0}
 {}
 
+std::shared_ptr<Package> Parser::create_package(
+  std::string name, SymbolTable& declarations)
+{
+  auto package = std::make_shared<Package>();
+  package->set_name(std::move(name));
+
+  std::shared_ptr<Class> int_class = std::make_shared<Class>();
+  int_class->set_name("int");
+  package->add(int_class);
+  declarations.bind(int_class->name(), int_class);
+  return package;
+}
+
+/*
+  Declarations are found by matching curly braces, so a class or function
+  keyword followed by a name is a declaration if it is not inside any body.
+  Package declarations and imports are collected the same way, and reported if
+  malformed. The definition phase then skips over them.
+*/
+void Parser::declare() {
+  if (!package_) {
+    declarations_ = std::make_shared<SymbolTable>();
+    package_ = create_package("default", *declarations_);
+  }
+  int depth = 0;
+  for (std::size_t index = 0; ; ++index) {
+    // Enough tokens to look ahead of a declaration
+    receive_tokens(index + 5);
+    auto iterator = tokens_->cbegin() + index;
+    const Token& token = *iterator;
+    if (token.type == TokenType::end) break;
+    switch (token.type) {
+      case TokenType::left_curly:
+        ++depth;
+        break;
+      case TokenType::right_curly:
+        if (depth > 0) --depth;
+        break;
+      case TokenType::import_keyword:
+        if (depth > 0) break;
+        if ((iterator + 1)->type == TokenType::identifier &&
+          (iterator + 2)->type == TokenType::dot &&
+          (iterator + 3)->type == TokenType::identifier &&
+          (iterator + 4)->type == TokenType::semicolon)
+        {
+          imports_.push_back(Import{*(iterator + 1), *(iterator + 3)});
+        } else {
+          error(token, "expected \"import PACKAGE.NAME;\"");
+        }
+        break;
+      case TokenType::package_keyword:
+        if (depth > 0) break;
+        if ((iterator + 1)->type == TokenType::identifier &&
+          (iterator + 2)->type == TokenType::semicolon)
+        {
+          if (package_name_) {
+            error(token, "duplicate package declaration");
+          } else {
+            package_name_ = *(iterator + 1);
+          }
+        } else {
+          error(token, "expected \"package NAME;\"");
+        }
+        break;
+      case TokenType::class_keyword:
+      case TokenType::func_keyword: {
+        const Token& name = *(iterator + 1);
+        if (depth > 0 || name.type != TokenType::identifier) break;
+        bool is_public = iterator != tokens_->cbegin() &&
+          (iterator - 1)->type == TokenType::pub_keyword;
+        // Annotations precede the function, and "pub" if present
+        std::vector<std::string> annotations;
+        if (token.type == TokenType::func_keyword) {
+          auto annotation = is_public ? iterator - 1 : iterator;
+          while (annotation - tokens_->cbegin() >= 2 &&
+            (annotation - 2)->type == TokenType::at &&
+            (annotation - 1)->type == TokenType::identifier)
+          {
+            annotation -= 2;
+            annotations.insert(annotations.begin(), (annotation + 1)->lexeme);
+          }
+        }
+        std::shared_ptr<Entity> entity;
+        if (token.type == TokenType::class_keyword) {
+          auto cls = std::make_shared<Class>();
+          cls->set_name(name.lexeme);
+          cls->set_public(is_public);
+          entity = cls;
+          if (declarations_->bind(name.lexeme, entity)) package_->add(cls);
+        } else {
+          auto function = std::make_shared<Function>();
+          function->set_name(name.lexeme);
+          function->set_return_type(ReturnType::none);
+          function->set_public(is_public);
+          for (std::string& annotation : annotations) {
+            function->add_annotation(std::move(annotation));
+          }
+          entity = function;
+          // Redefined functions are still parsed, but left out of the package
+          if (declarations_->bind(name.lexeme, entity)) {
+            package_->add(function);
+          }
+          declared_.emplace_back(iterator - tokens_->cbegin(), function);
+        }
+        if (declarations_->lookup(name.lexeme) != entity) {
+          error(name, "redefinition of \"" + name.lexeme + "\"");
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+void Parser::define() {
+  assert(!token_ring_ && "tokens must be declared before they are defined");
+  // Tokens received while declaring may have moved
+  iterator_ = tokens_->cbegin();
+  auto file_symbols = std::make_shared<SymbolTable>();
+  file_symbols->set_outer(declarations_);
+  bind_imports(*file_symbols);
+  symbols_.set_outer(file_symbols);
+  int_class_ = declarations_->lookup_as<Class>("int");
+  body_context_ = std::make_shared<const BodyContext>(
+    BodyContext{tokens_, file_name_, diagnostics_, file_symbols, int_class_});
+  parse();
+}
+
+// Binds each imported entity, resolved through its package, in file_symbols
+void Parser::bind_imports(SymbolTable& file_symbols) {
+  for (const Import& import : imports_) {
+    const std::string& package_name = import.package.lexeme;
+    const std::string& name = import.name.lexeme;
+    std::shared_ptr<const SymbolTable> package;
+    if (import_resolver_) package = import_resolver_(package_name);
+    if (!package) {
+      error(import.package,
+        "cannot import package \"" + package_name + "\"");
+      continue;
+    }
+    std::shared_ptr<Entity> entity = package->lookup(name);
+    if (!entity) {
+      error(import.name, "package \"" + package_name +
+        "\" has no entity \"" + name + "\"");
+    } else if (!is_public(*entity)) {
+      error(import.name, "\"" + name + "\" is not public in package \"" +
+        package_name + "\"");
+    } else if (declarations_->lookup(name)) {
+      error(import.name,
+        "import of \"" + name + "\" conflicts with a declaration");
+    } else if (!file_symbols.bind(name, entity)) {
+      error(import.name, "\"" + name + "\" is already imported");
+    }
+  }
+}
+
+std::shared_ptr<Package> Parser::run() {
+  declare();
+  define();
+
+  /*
+    Bodies only modify their own function, and only read the signatures of
+    other functions, which are complete by now, so they can be loaded in any
+    order.
+  */
+  if (thread_pool_) {
+    thread_pool_->parallel_for(functions_.size(), [&](std::size_t i) {
+      functions_[i]->load_body();
+    });
+  } else if (!lazy_bodies_) {
+    for (const auto& function : functions_) {
+      function->load_body();
+    }
+  }
+  return package_;
+}
+
+/*
+  Parses the statements of a function body, starting after its opening curly
+  brace, with the names visible in the file and the function's parameters in
+  scope.
+*/
+void Parser::load_body(
+  const BodyContext& context, std::size_t position, Function& function)
+{
+  Parser parser{context.tokens, position};
+  parser.diagnostics_ = context.diagnostics;
+  parser.file_name_ = context.file_name;
+  parser.body_only_ = true;
+  parser.function_ =
+    std::dynamic_pointer_cast<Function>(function.shared_from_this());
+  parser.symbols_.set_outer(context.file_symbols);
+  parser.int_class_ = context.int_class;
+  parser.symbols_.enter_scope();
+  // Parameters hiding a class were reported and left unbound when declared
+  for (const auto& object : function.object_entities()) {
+    if (!parser.symbols_.lookup_as<Class>(object->name())) {
+      parser.symbols_.bind(object->name(), object);
+    }
+  }
+  parser.state_ = ParserState::statement;
+  parser.parse();
+}
+
 /*
   The parser is implemented as a state machine, with the following additional
   properties:
     - An iterator into the token list is maintained, indicating the current
       token. The index will only ever be incremented.
-    - If an unexpected token type is encounted, the compiler will terminate and
-      an error message will be printed.
+    - The tokens of each function body are skipped, and later parsed by a
+      separate parser, starting in the statement state.
+    - If an unexpected token type is encountered, an error is reported, and
+      the parser recovers by skipping to the end of the statement (a semicolon
+      or closing curly brace) or of the definition, then continues (see
+      recover).
     - As the graph is being constructed, references to specific graph entities
       are maintained in order to keep track of where new entities should be
-      inserted. This includes the current package, current function, etc.
-*/
-std::shared_ptr<Package> Parser::run() {
-  package_ = std::make_shared<Package>();
-  package_->set_name("default");
-
-  std::shared_ptr<Class> int_class = std::make_shared<Class>();
-  int_class->set_name("int");
-  package_->add(int_class);
+      inserted. This includes the current function, current object, etc.
+    - Names are resolved through the symbol table, which has the index of
+      names declared in the package as its outer table, and a scope for each
+      function.
+    - Expressions are parsed by precedence climbing, using a stack of operands
+      and a stack of operators that have not yet been applied (see
+      push_operator).
 
+  Runs until the end of the tokens, or of the function body.
+*/
+void Parser::parse() {
   while (true) {
     switch (state_) {
       case ParserState::start:
         switch (current_token().type) {
           case TokenType::end:
-            return package_;
-          case TokenType::func_keyword:
-            function_ = std::make_shared<Function>();
-            function_->set_return_type(ReturnType::none);
-            package_->add(function_);
+            return;
+          case TokenType::class_keyword:
+            state_ = ParserState::class_name;
+            advance_token();
+            break;
+          case TokenType::import_keyword:
+          case TokenType::package_keyword:
+            // Already collected by declare()
+            skip_statement();
+            break;
+          case TokenType::at: {
+            // Already applied to the declared function by declare()
+            if ((iterator_ + 1)->type != TokenType::identifier) {
+              fail("expected annotation name after \"@\"");
+              break;
+            }
+            TokenType next = (iterator_ + 2)->type;
+            if (next == TokenType::pub_keyword) {
+              next = (iterator_ + 3)->type;
+            }
+            if (next != TokenType::at && next != TokenType::func_keyword) {
+              fail("expected function after annotation");
+              break;
+            }
+            advance_token();
+            advance_token();
+            break;
+          }
+          case TokenType::pub_keyword: {
+            // Already applied to the declared entity by declare()
+            TokenType next = (iterator_ + 1)->type;
+            if (next != TokenType::class_keyword &&
+              next != TokenType::func_keyword)
+            {
+              fail("expected class or function after \"pub\"");
+              break;
+            }
+            advance_token();
+            break;
+          }
+          case TokenType::func_keyword: {
+            // Continue the function added by declare(), if any
+            std::size_t position = iterator_ - tokens_->cbegin();
+            while (next_declared_ < declared_.size() &&
+              declared_[next_declared_].first < position)
+            {
+              ++next_declared_;
+            }
+            if (next_declared_ < declared_.size() &&
+              declared_[next_declared_].first == position)
+            {
+              function_ = declared_[next_declared_++].second;
+            } else {
+              function_ = std::make_shared<Function>();
+              function_->set_return_type(ReturnType::none);
+            }
+            functions_.push_back(function_);
+            symbols_.enter_scope();
             state_ = ParserState::func_name;
             advance_token();
             break;
+          }
+          default:
+            fail("expected class or function definition");
+            break;
+        }
+        break;
+      case ParserState::class_name:
+        switch (current_token().type) {
+          case TokenType::identifier:
+            state_ = ParserState::class_body_start;
+            advance_token();
+            break;
+          default:
+            fail();
+            break;
+        }
+        break;
+      case ParserState::class_body_start:
+        switch (current_token().type) {
+          case TokenType::left_curly:
+            state_ = ParserState::class_body_end;
+            advance_token();
+            break;
           default:
             fail();
+            break;
+        }
+        break;
+      case ParserState::class_body_end:
+        switch (current_token().type) {
+          case TokenType::right_curly:
+            state_ = ParserState::start;
+            advance_token();
+            break;
+          default:
+            fail("classes cannot have members yet");
+            break;
         }
         break;
       case ParserState::func_name:
         switch (current_token().type) {
           case TokenType::identifier:
-            function_->set_name(current_token().lexeme);
             state_ = ParserState::func_params_start;
             advance_token();
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_params_start:
@@ -111,6 +502,7 @@ std::shared_ptr<Package> Parser::run() {
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_param_or_end:
@@ -127,8 +519,11 @@ std::shared_ptr<Package> Parser::run() {
       case ParserState::func_param:
         switch (current_token().type) {
           case TokenType::identifier:
-            cls_ = package_->get_class(current_token().lexeme);
-            if (!cls_) fail();
+            cls_ = symbols_.lookup_as<Class>(current_token().lexeme);
+            if (!cls_) {
+              fail("unknown class \"" + current_token().lexeme + "\"");
+              break;
+            }
             object_ = std::make_shared<Object>();
             object_->set_cls(cls_);
             function_->add(object_);
@@ -137,17 +532,24 @@ std::shared_ptr<Package> Parser::run() {
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_param_name:
         switch (current_token().type) {
           case TokenType::identifier:
             object_->set_name(current_token().lexeme);
+            if (symbols_.lookup_as<Class>(object_->name())) {
+              error("parameter \"" + object_->name() + "\" hides a class");
+            } else if (!symbols_.bind(object_->name(), object_)) {
+              error("redefinition of parameter \"" + object_->name() + "\"");
+            }
             state_ = ParserState::func_params_next_or_end;
             advance_token();
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_params_next_or_end:
@@ -162,6 +564,7 @@ std::shared_ptr<Package> Parser::run() {
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_return_clause:
@@ -178,8 +581,11 @@ std::shared_ptr<Package> Parser::run() {
       case ParserState::func_return_type:
         switch (current_token().type) {
           case TokenType::identifier:
-            cls_ = package_->get_class(current_token().lexeme);
-            if (!cls_) fail();
+            cls_ = symbols_.lookup_as<Class>(current_token().lexeme);
+            if (!cls_) {
+              fail("unknown class \"" + current_token().lexeme + "\"");
+              break;
+            }
             function_->set_return_type(ReturnType::value);
             function_->set_return_class(cls_);
             state_ = ParserState::func_body;
@@ -187,21 +593,36 @@ std::shared_ptr<Package> Parser::run() {
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::func_body:
         switch (current_token().type) {
           case TokenType::left_curly:
-            state_ = ParserState::statement;
+            advance_token();
+            skip_body();
+            symbols_.exit_scope();
+            state_ = ParserState::start;
+            break;
+          case TokenType::semicolon:
+            if (!interface_) {
+              fail();
+              break;
+            }
+            symbols_.exit_scope();
+            state_ = ParserState::start;
             advance_token();
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::statement:
         switch (current_token().type) {
           case TokenType::right_curly:
+            symbols_.exit_scope();
+            if (body_only_) return;
             state_ = ParserState::start;
             advance_token();
             break;
@@ -211,56 +632,118 @@ std::shared_ptr<Package> Parser::run() {
             state_ = ParserState::expression_value;
             advance_token();
             break;
+          case TokenType::identifier:
+          case TokenType::integer:
+          case TokenType::left_paren:
+            state_ = ParserState::expression_value;
+            break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::expression_value:
         switch (current_token().type) {
-          case TokenType::identifier:
-            object_ = function_->get_object(current_token().lexeme);
-            if (!object_) fail();
-            object_expression_ = std::make_shared<ObjectExpression>();
-            object_expression_->set_object(object_);
+          case TokenType::identifier: {
+            std::shared_ptr<Entity> entity =
+              symbols_.lookup(current_token().lexeme);
+            if (auto function = std::dynamic_pointer_cast<Function>(entity)) {
+              advance_token();
+              if (current_token().type != TokenType::left_paren) {
+                fail("expected \"(\" after function \"" + function->name() +
+                  "\"");
+                break;
+              }
+              auto call_expression = std::make_shared<CallExpression>();
+              call_expression->set_function(function);
+              calls_.push_back(
+                Call{call_expression, operators_.size(), operands_.size()});
+              operators_.push_back(std::nullopt);
+              advance_token();
+              break;
+            }
+            object_ = std::dynamic_pointer_cast<Object>(entity);
+            if (!object_) {
+              fail("unknown object \"" + current_token().lexeme + "\"");
+              break;
+            }
+            auto object_expression = std::make_shared<ObjectExpression>();
+            object_expression->set_object(object_);
+            operands_.push_back(Operand{object_expression, false});
+            state_ = ParserState::expression_operator;
+            advance_token();
+            break;
+          }
+          case TokenType::integer: {
+            // Integer literals are ints, so must fit in 32 bits
+            const std::string& lexeme = current_token().lexeme;
+            std::int64_t value = 0;
+            auto [end, result] = std::from_chars(
+              lexeme.data(), lexeme.data() + lexeme.size(), value);
+            if (result != std::errc{} ||
+              value > std::numeric_limits<std::int32_t>::max())
+            {
+              fail("integer \"" + lexeme + "\" is too large");
+              break;
+            }
+            auto integer_expression = std::make_shared<IntegerExpression>();
+            integer_expression->set_value(value);
+            integer_expression->set_cls(int_class_);
+            operands_.push_back(Operand{integer_expression, false});
+            state_ = ParserState::expression_operator;
+            advance_token();
+            break;
+          }
+          case TokenType::left_paren:
+            operators_.push_back(std::nullopt);
+            advance_token();
+            break;
+          case TokenType::right_paren:
+            // Only a call without arguments may be closed here
+            if (!in_call() ||
+              !calls_.back().expression->expression_entities().empty() ||
+              operands_.size() != calls_.back().operands)
+            {
+              fail();
+              break;
+            }
+            if (!close_paren()) break;
             state_ = ParserState::expression_operator;
             advance_token();
             break;
           default:
             fail();
+            break;
         }
         break;
       case ParserState::expression_operator:
         switch (current_token().type) {
           case TokenType::semicolon:
-            if (operator_expression_) {
-              operator_expression_->add(object_expression_);
-              return_statement_->set_expression(operator_expression_);
-              operator_expression_.reset();
-            } else {
-              return_statement_->set_expression(object_expression_);
-            }
-            object_expression_.reset();
+            if (!end_expression()) break;
             state_ = ParserState::statement;
             advance_token();
             break;
-          case TokenType::plus: {
-            std::shared_ptr<OperatorExpression> operator_expression =
-              std::make_shared<OperatorExpression>();
-            operator_expression->set_operator_type(OperatorType::plus);
-            if (operator_expression_) {
-              operator_expression_->add(object_expression_);
-              operator_expression->add(operator_expression_);
-            } else {
-              operator_expression->add(object_expression_);
+          case TokenType::right_paren:
+            if (!close_paren()) break;
+            advance_token();
+            break;
+          case TokenType::comma:
+            if (!add_argument()) break;
+            state_ = ParserState::expression_value;
+            advance_token();
+            break;
+          default: {
+            std::optional<OperatorType> operator_type =
+              get_operator_type(current_token().type);
+            if (!operator_type) {
+              fail();
+              break;
             }
-            operator_expression_ = operator_expression;
-            object_expression_.reset();
+            if (!push_operator(*operator_type)) break;
             state_ = ParserState::expression_value;
             advance_token();
             break;
           }
-          default:
-            fail();
         }
       break;
     }
@@ -273,8 +756,328 @@ void Parser::advance_token() {
   ++iterator_;
 }
 
-// Prints an error message referencing the current token, and exits
+/*
+  Receives batches of tokens from the token ring until there are at least count
+  tokens, or until the end token is received
+*/
+void Parser::receive_tokens(std::size_t count) {
+  while (token_ring_ && received_tokens_->size() < count) {
+    std::vector<Token> batch = token_ring_->pop();
+    if (!batch.empty() && batch.back().type == TokenType::end) {
+      token_ring_.reset();
+    }
+    received_tokens_->insert(received_tokens_->end(),
+      std::make_move_iterator(batch.begin()),
+      std::make_move_iterator(batch.end()));
+  }
+}
+
+/*
+  Skips to the token after the closing curly brace of the current function
+  body, and sets a loader on the function to parse the body later
+*/
+void Parser::skip_body() {
+  std::size_t body = iterator_ - tokens_->cbegin();
+  for (int depth = 1; depth > 0; advance_token()) {
+    switch (current_token().type) {
+      case TokenType::end:
+        error("expected \"}\" at end of function body");
+        return;
+      case TokenType::left_curly:
+        ++depth;
+        break;
+      case TokenType::right_curly:
+        --depth;
+        break;
+      default:
+        break;
+    }
+  }
+  function_->set_body_loader(
+    [context = body_context_, body](Function& function) {
+      load_body(*context, body, function);
+    });
+}
+
+/*
+  Skips to the token after the closing curly brace of the current definition,
+  or to the next class or function keyword outside of curly braces, whichever
+  is first
+*/
+void Parser::skip_definition() {
+  int depth = 0;
+  while (current_token().type != TokenType::end) {
+    if ((current_token().type == TokenType::class_keyword ||
+      current_token().type == TokenType::func_keyword) && depth == 0)
+    {
+      return;
+    }
+    if (current_token().type == TokenType::left_curly) {
+      ++depth;
+    } else if (current_token().type == TokenType::right_curly &&
+      --depth <= 0)
+    {
+      advance_token();
+      return;
+    }
+    advance_token();
+  }
+}
+
+/*
+  Skips to the token after the next semicolon, or to the next class or function
+  keyword, whichever is first
+*/
+void Parser::skip_statement() {
+  while (true) {
+    switch (current_token().type) {
+      case TokenType::class_keyword:
+      case TokenType::end:
+      case TokenType::func_keyword:
+        return;
+      case TokenType::semicolon:
+        advance_token();
+        return;
+      default:
+        advance_token();
+        break;
+    }
+  }
+}
+
+/*
+  Applies pending operators that bind at least as tightly as operator_type
+  (or strictly more tightly, for assignments, which group right to left), then
+  pushes operator_type as pending. Returns false if an error was reported.
+*/
+bool Parser::push_operator(OperatorType operator_type) {
+  int precedence = get_precedence(operator_type);
+  while (!operators_.empty() && operators_.back()) {
+    int pending_precedence = get_precedence(*operators_.back());
+    if (pending_precedence < precedence) break;
+    if (pending_precedence == precedence && is_assignment(operator_type)) {
+      break;
+    }
+    if (!apply_operator()) return false;
+  }
+  operators_.push_back(operator_type);
+  return true;
+}
+
+/*
+  Combines the top two operands with the top pending operator. If the left
+  operand is an ungrouped expression of the same operator, which can only be
+  the case for operators grouping left to right, the right operand is appended
+  to it instead of nesting it, so that chains such as a+b+c+d become a single
+  flat operator expression. Returns false if an error was reported.
+*/
+bool Parser::apply_operator() {
+  OperatorType operator_type = *operators_.back();
+  operators_.pop_back();
+  Operand right = std::move(operands_.back());
+  operands_.pop_back();
+  Operand& left = operands_.back();
+
+  if (is_assignment(operator_type) &&
+    !dynamic_cast<const ObjectExpression*>(left.expression.get()))
+  {
+    fail("left operand of assignment is not an object");
+    return false;
+  }
+  auto left_operator =
+    std::dynamic_pointer_cast<OperatorExpression>(left.expression);
+  if (left_operator && !left.grouped && !is_assignment(operator_type) &&
+    left_operator->operator_type() == operator_type)
+  {
+    left_operator->add(right.expression);
+    return true;
+  }
+  auto operator_expression = std::make_shared<OperatorExpression>();
+  operator_expression->set_operator_type(operator_type);
+  operator_expression->add(left.expression);
+  operator_expression->add(right.expression);
+  left = Operand{operator_expression, false};
+  return true;
+}
+
+/*
+  Applies the operators pending since the innermost open parenthesis. Returns
+  false if an error was reported.
+*/
+bool Parser::apply_operators() {
+  while (!operators_.empty() && operators_.back()) {
+    if (!apply_operator()) return false;
+  }
+  return true;
+}
+
+// Whether the innermost open parenthesis starts the arguments of a call
+bool Parser::in_call() const {
+  return !calls_.empty() && calls_.back().paren + 1 == operators_.size();
+}
+
+/*
+  Applies the operators of the argument being parsed, then adds it to the
+  innermost call. Returns false if an error was reported.
+*/
+bool Parser::add_argument() {
+  if (!apply_operators()) return false;
+  if (!in_call()) {
+    fail();
+    return false;
+  }
+  calls_.back().expression->add(operands_.back().expression);
+  operands_.pop_back();
+  return true;
+}
+
+/*
+  Applies the operators inside the innermost parentheses, then closes them. If
+  they enclose the arguments of a call, the call becomes an operand. Returns
+  false if an error was reported.
+*/
+bool Parser::close_paren() {
+  if (!apply_operators()) return false;
+  if (operators_.empty()) {
+    fail("unmatched \")\"");
+    return false;
+  }
+  if (!in_call()) {
+    operators_.pop_back();
+    operands_.back().grouped = true;
+    return true;
+  }
+
+  Call call = std::move(calls_.back());
+  if (operands_.size() > call.operands) {
+    call.expression->add(operands_.back().expression);
+    operands_.pop_back();
+  }
+  calls_.pop_back();
+  operators_.pop_back();
+  const Function& function = *call.expression->function();
+  std::size_t parameters = function.object_entities().size();
+  std::size_t arguments = call.expression->expression_entities().size();
+  if (arguments != parameters) {
+    error("function \"" + function.name() + "\" takes " +
+      std::to_string(parameters) + " arguments, but " +
+      std::to_string(arguments) + " were given");
+  }
+  operands_.push_back(Operand{call.expression, false});
+  return true;
+}
+
+/*
+  Applies all pending operators, then adds the resulting expression to the
+  current return statement, or to the function as an expression statement.
+  Returns false if an error was reported.
+*/
+bool Parser::end_expression() {
+  while (!operators_.empty()) {
+    if (!operators_.back()) {
+      fail("expected \")\"");
+      return false;
+    }
+    if (!apply_operator()) return false;
+  }
+  std::shared_ptr<Expression> expression = operands_.back().expression;
+  operands_.clear();
+  if (return_statement_) {
+    return_statement_->set_expression(expression);
+    return_statement_.reset();
+  } else {
+    function_->add(expression);
+  }
+  return true;
+}
+
+// Reports an error at the current token, without recovering
+void Parser::error(const std::string& message) {
+  error(current_token(), message);
+}
+
+// Reports an error at the given token, without recovering
+void Parser::error(const Token& token, const std::string& message) {
+  diagnostics_->report(Diagnostic{Severity::error, file_name_,
+    token.line_number, token.column_number, message});
+}
+
+// Reports the current token as unexpected, and recovers
 void Parser::fail() {
-  std::cerr << "error: unexpected token " << current_token() << std::endl;
-  std::exit(EXIT_FAILURE);
-}
\ No newline at end of file
+  if (current_token().type == TokenType::end) {
+    fail("unexpected end of file");
+  } else {
+    fail("unexpected \"" + current_token().lexeme + "\"");
+  }
+}
+
+// Reports an error at the current token, and recovers
+void Parser::fail(const std::string& message) {
+  error(message);
+  recover();
+}
+
+/*
+  Skips tokens until parsing can resume after an error, discarding the
+  partially parsed statement or definition:
+    - Inside a function body, parsing resumes at the next statement, after a
+      semicolon or at a closing curly brace.
+    - Inside a function signature or class definition, the rest of the
+      definition is skipped, and parsing resumes at the next definition.
+    - At the top level, parsing resumes at the next definition, package
+      declaration, or import.
+  Unless the current token starts a statement or definition in the state
+  parsing resumes in, at least one token is skipped, so parsing always ends.
+*/
+void Parser::recover() {
+  switch (state_) {
+    case ParserState::expression_operator:
+    case ParserState::expression_value:
+    case ParserState::statement:
+      operands_.clear();
+      operators_.clear();
+      calls_.clear();
+      if (return_statement_) {
+        function_->remove(return_statement_);
+        return_statement_.reset();
+      }
+      while (true) {
+        switch (current_token().type) {
+          case TokenType::end:
+            state_ = ParserState::start;
+            return;
+          case TokenType::semicolon:
+            state_ = ParserState::statement;
+            advance_token();
+            return;
+          case TokenType::right_curly:
+            state_ = ParserState::statement;
+            return;
+          default:
+            advance_token();
+            break;
+        }
+      }
+    case ParserState::start:
+      while (current_token().type != TokenType::end &&
+        current_token().type != TokenType::class_keyword &&
+        current_token().type != TokenType::func_keyword &&
+        current_token().type != TokenType::import_keyword &&
+        current_token().type != TokenType::package_keyword)
+      {
+        advance_token();
+      }
+      return;
+    case ParserState::class_body_end:
+    case ParserState::class_body_start:
+    case ParserState::class_name:
+      skip_definition();
+      state_ = ParserState::start;
+      return;
+    default:
+      skip_definition();
+      symbols_.exit_scope();
+      state_ = ParserState::start;
+      return;
+  }
+}
@@ -23,39 +23,288 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
+#include <utility>
 #include <vector>
+#include "diagnostics.h"
 #include "graph.h"
+#include "spsc_ring.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
 #include "token.h"
 
 enum class ParserState;
 
+// Batches of tokens passed from a lexer thread to a parser (see Lexer::run)
+using TokenRing = SpscRing<std::vector<Token>>;
+
 // Converts a list of tokens into a program graph
 class Parser {
 public:
+  // An import of an entity from another package, such as "import b.f;"
+  struct Import {
+    // Token naming the imported package
+    Token package;
+    // Token naming the imported entity
+    Token name;
+  };
+
+  /*
+    Returns the index of names declared in the package with the given name, or
+    nullptr if the package cannot be imported.
+  */
+  using ImportResolver = std::function<
+    std::shared_ptr<const SymbolTable>(const std::string& package_name)>;
+
   /*
     The token list must be passed on construction, and it must include a
     terminating "end" token.
   */
   Parser(std::vector<Token> tokens);
 
-  // Runs the parser, returning the top-level entity of the program graph
+  /*
+    Receives the tokens in batches from token_ring while declaring, so that
+    the tokens can be declared while the rest are still being lexed. The last
+    batch must end with the "end" token.
+  */
+  Parser(std::shared_ptr<TokenRing> token_ring);
+
+  // Sets the name of the source file, used in diagnostics. Defaults to empty.
+  void set_file_name(std::string file_name) {
+    file_name_ = std::move(file_name);
+  }
+
+  /*
+    Sets the diagnostics collection that errors are reported to. Defaults to a
+    collection owned by the parser.
+  */
+  void set_diagnostics(std::shared_ptr<Diagnostics> diagnostics) {
+    diagnostics_ = std::move(diagnostics);
+  }
+
+  /*
+    Diagnostics reported while parsing. Errors in lazily parsed function bodies
+    are only reported once the bodies are loaded.
+  */
+  const std::shared_ptr<Diagnostics>& diagnostics() const {
+    return diagnostics_;
+  }
+
+  /*
+    Sets the package that the tokens are parsed into, along with the index of
+    the names declared at the top level of the package. A package made of
+    multiple files is parsed by one parser per file, all sharing the package
+    and the index. Defaults to a new package named "default".
+  */
+  void set_package(
+    std::shared_ptr<Package> package, std::shared_ptr<SymbolTable> declarations)
+  {
+    package_ = std::move(package);
+    declarations_ = std::move(declarations);
+  }
+
+  /*
+    Creates an empty package with the given name, containing the built in
+    classes, which are also added to the index of declared names.
+  */
+  static std::shared_ptr<Package> create_package(
+    std::string name, SymbolTable& declarations);
+
+  /*
+    Sets whether function bodies are parsed lazily. If so, the parser only
+    matches the curly braces of each function body, and the statements are
+    parsed the first time they are needed (see Function::load_body). Defaults
+    to false.
+  */
+  void set_lazy_bodies(bool lazy_bodies) { lazy_bodies_ = lazy_bodies; }
+
+  /*
+    Sets a thread pool for parsing function bodies in parallel. If set, the
+    bodies are parsed on the pool once all signatures are parsed, each into
+    its own function. The resulting graph is identical to the one parsed
+    sequentially. Defaults to nullptr (sequential parsing).
+  */
+  void set_thread_pool(ThreadPool* thread_pool) { thread_pool_ = thread_pool; }
+
+  /*
+    Sets whether the tokens are a package interface (see interface.h), in
+    which functions are declared with a semicolon in place of their body.
+    Defaults to false.
+  */
+  void set_interface(bool interface) { interface_ = interface; }
+
+  /*
+    Sets the function used to resolve the packages named by imports. Defaults
+    to none, in which case every import is reported as an error.
+  */
+  void set_import_resolver(ImportResolver import_resolver) {
+    import_resolver_ = std::move(import_resolver);
+  }
+
+  /*
+    First parsing phase: adds a class or function to the package for each one
+    declared at the top level, and binds its name in the index of declared
+    names. Only the names are parsed, in a single scan over the tokens that
+    matches curly braces. Since all files of a package are declared before any
+    of them are defined, classes and functions may be used anywhere in the
+    package, regardless of the order of the definitions or of the files.
+
+    The package declaration and imports at the top level are also collected,
+    so that imported packages can be loaded before the definitions are parsed.
+
+    Modifies the package and the index, so parsers sharing them must declare
+    one at a time.
+  */
+  void declare();
+
+  /*
+    Token naming the package in the package declaration, such as "package a;",
+    if there is one. Available after declare().
+  */
+  const std::optional<Token>& package_name() const { return package_name_; }
+
+  // Imports at the top level, in order. Available after declare().
+  const std::vector<Import>& imports() const { return imports_; }
+
+  /*
+    Second parsing phase, after all files of the package are declared: parses
+    the definitions of the classes and functions, resolving names through the
+    imported entities and then the index of declared names. Only public
+    entities may be imported. Function bodies are not parsed; instead, a loader
+    is set on each function (see Function::set_body_loader), which parses the
+    body without parsing any other tokens again.
+
+    Only modifies the functions defined in the tokens, so parsers sharing a
+    package may define concurrently. Function bodies must not be loaded until
+    all files of the package are defined, since bodies read the signatures of
+    the functions they call.
+  */
+  void define();
+
+  /*
+    Parses the tokens as the only file of the package, returning the package.
+    The tokens are declared and defined, and then function bodies are parsed,
+    unless they are parsed lazily.
+
+    On errors, the parser reports a diagnostic, skips ahead to the end of the
+    statement or declaration, and continues, so that all errors are reported
+    in one run. If any errors were reported, the graph is incomplete, and must
+    not be translated.
+  */
   std::shared_ptr<Package> run();
 
+  /*
+    Functions defined in the tokens, in the order of their definitions.
+    Available after define().
+  */
+  const std::vector<std::shared_ptr<Function>>& functions() const {
+    return functions_;
+  }
+
 private:
-  std::vector<Token> tokens_;
+  /*
+    What the loaders of lazily parsed function bodies need from the parser. A
+    function holds the context until its body is loaded, so the names visible
+    in the file remain available even after the parser is gone.
+  */
+  struct BodyContext {
+    std::shared_ptr<const std::vector<Token>> tokens;
+    std::string file_name;
+    std::shared_ptr<Diagnostics> diagnostics;
+    // Imported entities, with the index of declared names as the outer table
+    std::shared_ptr<const SymbolTable> file_symbols;
+    std::shared_ptr<Class> int_class;
+  };
+
+  Parser(std::shared_ptr<const std::vector<Token>> tokens,
+    std::size_t position);
+
+  static void load_body(
+    const BodyContext& context, std::size_t position, Function& function);
+
+  std::shared_ptr<const std::vector<Token>> tokens_;
+  // Where the rest of the tokens are received from, until the end token
+  std::shared_ptr<TokenRing> token_ring_;
+  // The tokens received so far, shared with tokens_
+  std::shared_ptr<std::vector<Token>> received_tokens_;
+  std::shared_ptr<Diagnostics> diagnostics_;
+  std::string file_name_;
   std::vector<Token>::const_iterator iterator_;
   ParserState state_;
+  bool lazy_bodies_;
+  ThreadPool* thread_pool_;
+  bool interface_;
+  // Whether only a single function body is being parsed
+  bool body_only_;
+  ImportResolver import_resolver_;
+  // Names visible at the current token, with one scope per function, and
+  // the names visible throughout the file as the outer table
+  SymbolTable symbols_;
+  // Shared with the loaders of lazily parsed function bodies
+  std::shared_ptr<const BodyContext> body_context_;
 
   std::shared_ptr<Package> package_;
+  // Names declared at the top level of the package
+  std::shared_ptr<SymbolTable> declarations_;
+  // The built in class of integer literals, which names in scope cannot hide
+  std::shared_ptr<Class> int_class_;
+  // Functions added to the package by declare(), with the index of their
+  // func keyword in the tokens, in order
+  std::vector<std::pair<std::size_t, std::shared_ptr<Function>>> declared_;
+  // Index into declared_ of the next function to be defined
+  std::size_t next_declared_;
+  std::vector<std::shared_ptr<Function>> functions_;
+  std::optional<Token> package_name_;
+  std::vector<Import> imports_;
+
   std::shared_ptr<Function> function_;
   std::shared_ptr<Object> object_;
   std::shared_ptr<Class> cls_;
   std::shared_ptr<ReturnStatement> return_statement_;
-  std::shared_ptr<ObjectExpression> object_expression_;
-  std::shared_ptr<OperatorExpression> operator_expression_;
 
+  // An operand of the expression being parsed
+  struct Operand {
+    std::shared_ptr<Expression> expression;
+    // Whether the operand was enclosed in parentheses
+    bool grouped;
+  };
+  // Operands of the expression being parsed that are not yet combined
+  std::vector<Operand> operands_;
+  // Operators of the expression being parsed that are not yet applied, with
+  // no value marking an open parenthesis
+  std::vector<std::optional<OperatorType>> operators_;
+  // A call of the expression being parsed whose arguments are being parsed
+  struct Call {
+    std::shared_ptr<CallExpression> expression;
+    // Index in operators_ of the call's open parenthesis
+    std::size_t paren;
+    // Number of operands before the call's arguments
+    std::size_t operands;
+  };
+  // Calls whose arguments are being parsed, innermost last
+  std::vector<Call> calls_;
+
+  void parse();
   const Token& current_token() const { return *iterator_; }
   void advance_token();
+  void receive_tokens(std::size_t count);
+  void skip_body();
+  void skip_definition();
+  void skip_statement();
+  void bind_imports(SymbolTable& file_symbols);
+  bool push_operator(OperatorType operator_type);
+  bool apply_operator();
+  bool apply_operators();
+  bool in_call() const;
+  bool add_argument();
+  bool close_paren();
+  bool end_expression();
+  void error(const std::string& message);
+  void error(const Token& token, const std::string& message);
   void fail();
-};
\ No newline at end of file
+  void fail(const std::string& message);
+  void recover();
+};
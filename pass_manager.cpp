@@ -0,0 +1,172 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "pass_manager.h"
+#include <dlfcn.h>
+#include <iomanip>
+#include <sstream>
+
+PassRegistry& PassRegistry::instance() {
+  static PassRegistry registry;
+  return registry;
+}
+
+void PassRegistry::add(std::string name, Factory factory) {
+  factories_[std::move(name)] = std::move(factory);
+}
+
+std::shared_ptr<Pass> PassRegistry::create(const std::string& name) const {
+  auto iter = factories_.find(name);
+  if (iter == factories_.cend()) return nullptr;
+  return iter->second();
+}
+
+std::vector<std::string> PassRegistry::names() const {
+  std::vector<std::string> names;
+  for (const auto& [name, factory] : factories_) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+bool PassRegistry::load_plugin(const std::string& path) {
+  // Plugins stay loaded for the lifetime of the compiler
+  void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!library) return false;
+  using RegisterFunction = void (*)(PassRegistry&);
+  auto register_passes = reinterpret_cast<RegisterFunction>(
+    dlsym(library, "veil_register_passes"));
+  if (!register_passes) return false;
+  register_passes(*this);
+  return true;
+}
+
+PassManager::PassManager(ThreadPool& thread_pool): thread_pool_{thread_pool} {}
+
+void PassManager::add(std::shared_ptr<Pass> pass) {
+  entries_.push_back(Entry{std::move(pass), std::chrono::nanoseconds{0}, 0});
+}
+
+void PassManager::add_analysis(
+  std::string name, std::function<void(std::shared_ptr<Package>)> compute)
+{
+  analyses_[std::move(name)] = std::move(compute);
+}
+
+/*
+  Consecutive function passes are collected into a pipeline, which is run when
+  a package pass or a pass that depends on an analysis invalidated inside the
+  pipeline is reached.
+*/
+void PassManager::run(std::shared_ptr<Package> package) {
+  std::vector<Entry*> pipeline;
+  std::set<std::string> pipeline_invalidates;
+  for (Entry& entry : entries_) {
+    if (entry.pass->granularity() == PassGranularity::function) {
+      for (const std::string& analysis : entry.pass->reads()) {
+        if (pipeline_invalidates.count(analysis)) {
+          run_functions(pipeline, package);
+          pipeline_invalidates.clear();
+          break;
+        }
+      }
+      prepare(entry, package);
+      pipeline.push_back(&entry);
+      for (const std::string& analysis : entry.pass->invalidates()) {
+        pipeline_invalidates.insert(analysis);
+      }
+    } else {
+      run_functions(pipeline, package);
+      pipeline_invalidates.clear();
+      prepare(entry, package);
+      auto start = std::chrono::steady_clock::now();
+      entry.pass->run_package(package);
+      entry.time += std::chrono::steady_clock::now() - start;
+      ++entry.runs;
+      finish(entry);
+    }
+  }
+  run_functions(pipeline, package);
+}
+
+std::vector<PassTiming> PassManager::timings() const {
+  std::vector<PassTiming> timings;
+  for (const Entry& entry : entries_) {
+    timings.push_back(PassTiming{entry.pass->name(), entry.time, entry.runs});
+  }
+  return timings;
+}
+
+// Computes any analyses read by the pass that are not currently valid
+void PassManager::prepare(Entry& entry, std::shared_ptr<Package> package) {
+  for (const std::string& analysis : entry.pass->reads()) {
+    if (valid_analyses_.count(analysis)) continue;
+    auto iter = analyses_.find(analysis);
+    if (iter != analyses_.cend()) {
+      iter->second(package);
+    }
+    valid_analyses_.insert(analysis);
+  }
+}
+
+// Marks the analyses invalidated by the pass as needing recomputation
+void PassManager::finish(const Entry& entry) {
+  for (const std::string& analysis : entry.pass->invalidates()) {
+    valid_analyses_.erase(analysis);
+  }
+}
+
+/*
+  Runs each pass of the pipeline over one function before moving on to the next
+  pass, with functions distributed over the thread pool. Times are recorded per
+  function and summed afterwards, so that workers do not contend on shared
+  counters.
+*/
+void PassManager::run_functions(
+  std::vector<Entry*>& pipeline, std::shared_ptr<Package> package)
+{
+  if (pipeline.empty()) return;
+  const auto& functions = package->function_entities();
+  std::vector<std::chrono::nanoseconds> times(
+    functions.size() * pipeline.size());
+  thread_pool_.parallel_for(functions.size(), [&](std::size_t i) {
+    for (std::size_t j = 0; j < pipeline.size(); ++j) {
+      auto start = std::chrono::steady_clock::now();
+      pipeline[j]->pass->run_function(functions[i]);
+      times[i * pipeline.size() + j] = std::chrono::steady_clock::now() - start;
+    }
+  });
+  for (std::size_t j = 0; j < pipeline.size(); ++j) {
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+      pipeline[j]->time += times[i * pipeline.size() + j];
+    }
+    pipeline[j]->runs += functions.size();
+    finish(*pipeline[j]);
+  }
+  pipeline.clear();
+}
+
+std::string print(const std::vector<PassTiming>& timings) {
+  std::ostringstream text;
+  for (const PassTiming& timing : timings) {
+    double milliseconds =
+      std::chrono::duration<double, std::milli>{timing.time}.count();
+    text << std::left << std::setw(24) << timing.name
+      << std::right << std::fixed << std::setprecision(3) << std::setw(12)
+      << milliseconds << " ms" << std::setw(10) << timing.runs << " runs\n";
+  }
+  return text.str();
+}
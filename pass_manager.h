@@ -0,0 +1,176 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Passes are units of work that read or modify the program graph between
+  parsing and translation, such as analyses and optimizations. The pass manager
+  runs a pipeline of passes over a package, deciding which passes may run
+  concurrently:
+    - Function passes only read and modify a single function, so consecutive
+      function passes are run as a pipeline on each function, with different
+      functions processed in parallel on a thread pool.
+    - Package passes may read and modify the whole package, so they run alone,
+      after all earlier passes have finished.
+    - Passes declare the analyses they read and invalidate. A function pass that
+      reads an analysis invalidated by an earlier pass in the same pipeline
+      starts a new pipeline, so the analysis can be recomputed in between.
+
+  Passes always run in the order they were added, and each function sees the
+  same sequence of passes, so the resulting graph does not depend on thread
+  scheduling.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "graph.h"
+#include "thread_pool.h"
+
+// The unit of the graph that a pass operates on
+enum class PassGranularity {
+  // The pass is run separately on each function of the package
+  function,
+  // The pass is run once on the whole package
+  package,
+};
+
+// Base class for all passes
+class Pass {
+public:
+  // Polymorphic
+  virtual ~Pass() = default;
+
+  // Unique name of the pass, used for registration and timing reports
+  virtual std::string name() const = 0;
+
+  // Whether the pass runs on each function or on the whole package
+  virtual PassGranularity granularity() const = 0;
+
+  // Names of the analyses whose results the pass reads
+  virtual std::vector<std::string> reads() const { return {}; }
+
+  // Names of the analyses whose results are no longer valid after the pass
+  virtual std::vector<std::string> invalidates() const { return {}; }
+
+  /*
+    Runs a function pass on a single function. May be called concurrently for
+    different functions, so it must not modify anything outside of function.
+  */
+  virtual void run_function(std::shared_ptr<Function> /*function*/) {}
+
+  // Runs a package pass on the whole package
+  virtual void run_package(std::shared_ptr<Package> /*package*/) {}
+};
+
+// Accumulated running time of a pass, summed over all of the threads
+struct PassTiming {
+  std::string name;
+  std::chrono::nanoseconds time;
+  // Number of times the pass was run (once per function, for function passes)
+  std::size_t runs;
+};
+
+/*
+  Maps pass names to functions that create the pass. Passes built into the
+  compiler register themselves on startup, and plugins register their passes
+  when loaded.
+*/
+class PassRegistry {
+public:
+  using Factory = std::function<std::shared_ptr<Pass>()>;
+
+  // The registry used by the compiler
+  static PassRegistry& instance();
+
+  // Registers a factory for the pass with the given name
+  void add(std::string name, Factory factory);
+
+  // Creates the pass with the given name, or returns nullptr if not registered
+  std::shared_ptr<Pass> create(const std::string& name) const;
+
+  // Names of all registered passes, in sorted order
+  std::vector<std::string> names() const;
+
+  /*
+    Loads a plugin from a shared library. The library must export the function
+    'extern "C" void veil_register_passes(PassRegistry&)', which is called to
+    register the plugin's passes. Returns false if the plugin could not be
+    loaded.
+  */
+  bool load_plugin(const std::string& path);
+
+private:
+  std::map<std::string, Factory> factories_;
+};
+
+// Registers PassT with PassRegistry::instance() during static initialization
+template<typename PassT> struct RegisterPass {
+  explicit RegisterPass(std::string name) {
+    PassRegistry::instance().add(
+      std::move(name), [] { return std::make_shared<PassT>(); });
+  }
+};
+
+// Runs a pipeline of passes over a package
+class PassManager {
+public:
+  // Function passes are run in parallel on the given thread pool
+  explicit PassManager(ThreadPool& thread_pool);
+
+  // Adds a pass to the end of the pipeline
+  void add(std::shared_ptr<Pass> pass);
+
+  /*
+    Registers the function that computes an analysis over a whole package. It
+    is called before running a pass that reads the analysis, if the analysis
+    has not been computed yet or was invalidated by an earlier pass.
+  */
+  void add_analysis(
+    std::string name, std::function<void(std::shared_ptr<Package>)> compute);
+
+  // Runs all passes, in order, over the package
+  void run(std::shared_ptr<Package> package);
+
+  // Time spent in each pass so far, in pipeline order
+  std::vector<PassTiming> timings() const;
+
+private:
+  struct Entry {
+    std::shared_ptr<Pass> pass;
+    std::chrono::nanoseconds time;
+    std::size_t runs;
+  };
+
+  void prepare(Entry& entry, std::shared_ptr<Package> package);
+  void finish(const Entry& entry);
+  void run_functions(
+    std::vector<Entry*>& pipeline, std::shared_ptr<Package> package);
+
+  ThreadPool& thread_pool_;
+  std::vector<Entry> entries_;
+  std::map<std::string, std::function<void(std::shared_ptr<Package>)>>
+    analyses_;
+  std::set<std::string> valid_analyses_;
+};
+
+// Formats pass timings as a table, one pass per line
+std::string print(const std::vector<PassTiming>& timings);
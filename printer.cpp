@@ -15,35 +15,153 @@
 */
 
 #include "printer.h"
+#include <algorithm>
+#include <vector>
 
-std::string print(
-  std::shared_ptr<Package> package, std::string::size_type indent)
+namespace {
+
+/*
+  Lines are indented by at most this many spaces. Deeper lines are prefixed by
+  their nesting level instead, so the text grows linearly with the depth of
+  the graph rather than quadratically.
+*/
+constexpr std::string::size_type max_indent = 64;
+
+// Appends a line of text at the given indent
+void append_line(
+  const std::string& line, std::string::size_type indent, std::string& text)
 {
-  std::string text(indent, ' ');
-  text += "Package:" + package->name() + "\n";
-  for (auto function : package->function_entities()) {
-    text += print(function, indent + 2);
+  if (indent > max_indent) {
+    text.append(max_indent, ' ');
+    text += "[" + std::to_string(indent / 2) + "] ";
+  } else {
+    text.append(indent, ' ');
   }
-  return text;
+  text += line;
+  text += '\n';
 }
 
-std::string print(
-  std::shared_ptr<Function> function, std::string::size_type indent)
+void append_class(
+  const Class& cls, std::string::size_type indent, std::string& text)
+{
+  append_line("Class:" + cls.name(), indent, text);
+}
+
+void append_object(
+  const Object& object, std::string::size_type indent, std::string& text)
+{
+  append_line("Object:" + object.name(), indent, text);
+  append_class(*object.cls(), indent + 2, text);
+}
+
+/*
+  Expressions may be nested arbitrarily deep, so instead of recursing, the
+  expressions still to be printed are kept on an explicit stack, along with
+  their indents.
+*/
+void append_expression(
+  const Expression& root, std::string::size_type indent, std::string& text)
+{
+  std::vector<std::pair<const Expression*, std::string::size_type>> stack{
+    {&root, indent}};
+  while (!stack.empty()) {
+    auto [expression, indent] = stack.back();
+    stack.pop_back();
+    if (auto operator_expression =
+      dynamic_cast<const OperatorExpression*>(expression))
+    {
+      append_line(
+        "OperatorExpression:" + print(operator_expression->operator_type()),
+        indent, text);
+      const auto& expressions = operator_expression->expression_entities();
+      for (auto it = expressions.crbegin(); it != expressions.crend(); ++it) {
+        stack.emplace_back(it->get(), indent + 2);
+      }
+    } else if (auto call_expression =
+      dynamic_cast<const CallExpression*>(expression))
+    {
+      append_line("CallExpression:" + call_expression->function()->name(),
+        indent, text);
+      const auto& arguments = call_expression->expression_entities();
+      for (auto it = arguments.crbegin(); it != arguments.crend(); ++it) {
+        stack.emplace_back(it->get(), indent + 2);
+      }
+    } else if (auto object_expression =
+      dynamic_cast<const ObjectExpression*>(expression))
+    {
+      append_line("ObjectExpression", indent, text);
+      append_object(*object_expression->object(), indent + 2, text);
+    } else if (auto integer_expression =
+      dynamic_cast<const IntegerExpression*>(expression))
+    {
+      append_line(
+        "IntegerExpression:" + std::to_string(integer_expression->value()),
+        indent, text);
+      append_class(*integer_expression->cls(), indent + 2, text);
+    } else {
+      text.append(std::min(indent, max_indent), ' ');
+    }
+  }
+}
+
+void append_statement(
+  const Statement& statement, std::string::size_type indent,
+  std::string& text)
+{
+  if (auto expression = dynamic_cast<const Expression*>(&statement)) {
+    append_expression(*expression, indent, text);
+  } else if (auto return_statement =
+    dynamic_cast<const ReturnStatement*>(&statement))
+  {
+    append_line("ReturnStatement", indent, text);
+    append_expression(*return_statement->expression(), indent + 2, text);
+  } else {
+    text.append(std::min(indent, max_indent), ' ');
+  }
+}
+
+// Appends the function, leaving out its statements unless with_body is set
+void append_function(
+  const Function& function, std::string::size_type indent, bool with_body,
+  std::string& text)
 {
-  std::string text(indent, ' ');
-  text += "Function:" + print(function->return_type()) + "\n";
-  if (function->return_type() == ReturnType::value) {
-    text += print(function->return_class(), indent + 2);
+  append_line("Function:" + print(function.return_type()), indent, text);
+  for (const std::string& annotation : function.annotations()) {
+    append_line("Annotation:" + annotation, indent + 2, text);
+  }
+  if (function.return_type() == ReturnType::value) {
+    append_class(*function.return_class(), indent + 2, text);
   }
-  for (auto object : function->object_entities()) {
-    text += print(object, indent + 2);
+  for (const auto& object : function.object_entities()) {
+    append_object(*object, indent + 2, text);
   }
-  for (auto statement : function->statement_entities()) {
-    text += print(statement, indent + 2);
+  if (!with_body) return;
+  for (const auto& statement : function.statement_entities()) {
+    append_statement(*statement, indent + 2, text);
+  }
+}
+
+}  // namespace
+
+std::string print(
+  const std::shared_ptr<Package>& package, std::string::size_type indent)
+{
+  std::string text;
+  append_line("Package:" + package->name(), indent, text);
+  for (const auto& function : package->function_entities()) {
+    append_function(*function, indent + 2, true, text);
   }
   return text;
 }
 
+std::string print(
+  const std::shared_ptr<Function>& function, std::string::size_type indent)
+{
+  std::string text;
+  append_function(*function, indent, true, text);
+  return text;
+}
+
 std::string print(ReturnType return_type) {
   switch (return_type) {
     case ReturnType::none:
@@ -56,62 +174,84 @@ std::string print(ReturnType return_type) {
 }
 
 std::string print(
-  std::shared_ptr<Class> cls, std::string::size_type indent)
+  const std::shared_ptr<Class>& cls, std::string::size_type indent)
 {
-  std::string text(indent, ' ');
-  text += "Class:" + cls->name() + "\n";
+  std::string text;
+  append_class(*cls, indent, text);
   return text;
 }
 
 std::string print(
-  std::shared_ptr<Object> object, std::string::size_type indent)
+  const std::shared_ptr<Object>& object, std::string::size_type indent)
 {
-  std::string text(indent, ' ');
-  text += "Object:" + object->name() + "\n";
-  text += print(object->cls(), indent + 2);
+  std::string text;
+  append_object(*object, indent, text);
   return text;
 }
 
 std::string print(
-  std::shared_ptr<Statement> statement, std::string::size_type indent)
+  const std::shared_ptr<Statement>& statement, std::string::size_type indent)
 {
-  std::string text(indent, ' ');
-  if (auto return_statement =
-    std::dynamic_pointer_cast<ReturnStatement>(statement))
-  {
-    text += "ReturnStatement\n";
-    text += print(return_statement->expression(), indent + 2);
-  }
+  std::string text;
+  append_statement(*statement, indent, text);
   return text;
 }
 
 std::string print(OperatorType operator_type) {
   switch (operator_type) {
+    case OperatorType::assign:
+      return std::string{"assign"};
+    case OperatorType::divide:
+      return std::string{"divide"};
+    case OperatorType::divide_assign:
+      return std::string{"divide_assign"};
+    case OperatorType::equal:
+      return std::string{"equal"};
+    case OperatorType::greater:
+      return std::string{"greater"};
+    case OperatorType::greater_equal:
+      return std::string{"greater_equal"};
+    case OperatorType::less:
+      return std::string{"less"};
+    case OperatorType::less_equal:
+      return std::string{"less_equal"};
+    case OperatorType::minus:
+      return std::string{"minus"};
+    case OperatorType::minus_assign:
+      return std::string{"minus_assign"};
+    case OperatorType::modulo:
+      return std::string{"modulo"};
+    case OperatorType::modulo_assign:
+      return std::string{"modulo_assign"};
+    case OperatorType::multiply:
+      return std::string{"multiply"};
+    case OperatorType::multiply_assign:
+      return std::string{"multiply_assign"};
+    case OperatorType::not_equal:
+      return std::string{"not_equal"};
     case OperatorType::plus:
       return std::string{"plus"};
+    case OperatorType::plus_assign:
+      return std::string{"plus_assign"};
     default:
       return std::string{"unknown"};
   }
 }
 
 std::string print(
-  std::shared_ptr<Expression> expression, std::string::size_type indent)
+  const std::shared_ptr<Expression>& expression,
+  std::string::size_type indent)
 {
-  std::string text(indent, ' ');
-  if (auto operator_expression =
-    std::dynamic_pointer_cast<OperatorExpression>(expression))
-  {
-    text += "OperatorExpression:" + print(operator_expression->operator_type())
-      + "\n";
-    for (auto expression : operator_expression->expression_entities()) {
-      text += print(expression, indent + 2);
-    }
-  }
-  else if (auto object_expression =
-    std::dynamic_pointer_cast<ObjectExpression>(expression))
-  {
-    text += "ObjectExpression\n";
-    text += print(object_expression->object(), indent + 2);
+  std::string text;
+  append_expression(*expression, indent, text);
+  return text;
+}
+
+std::string print_summary(const std::shared_ptr<Package>& package) {
+  std::string text;
+  append_line("Package:" + package->name(), 0, text);
+  for (const auto& function : package->function_entities()) {
+    append_function(*function, 2, false, text);
   }
   return text;
 }
\ No newline at end of file
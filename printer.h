@@ -27,20 +27,32 @@
 
 /*
   These functions convert the given graph entity into a textual respresentation,
-  recursively converting child entities into the same string. The indenting
-  defaults to 0, and is incremented by 2 each time a child is visited.
+  converting child entities into the same string. The indenting defaults to 0,
+  and is incremented by 2 each time a child is visited. Expressions are visited
+  without recursion, so arbitrarily deep expressions can be printed. Past a
+  fixed indent, lines are prefixed by their nesting level, such as
+  "[40] ObjectExpression", instead of being indented further.
 */
 std::string print(
-  std::shared_ptr<Package> package, std::string::size_type indent = 0);
+  const std::shared_ptr<Package>& package, std::string::size_type indent = 0);
 std::string print(
-  std::shared_ptr<Function> function, std::string::size_type indent = 0);
+  const std::shared_ptr<Function>& function, std::string::size_type indent = 0);
 std::string print(ReturnType return_type);
 std::string print(
-  std::shared_ptr<Class> cls, std::string::size_type indent = 0);
+  const std::shared_ptr<Class>& cls, std::string::size_type indent = 0);
 std::string print(
-  std::shared_ptr<Object> object, std::string::size_type indent = 0);
+  const std::shared_ptr<Object>& object, std::string::size_type indent = 0);
 std::string print(
-  std::shared_ptr<Statement> statement, std::string::size_type indent = 0);
+  const std::shared_ptr<Statement>& statement,
+  std::string::size_type indent = 0);
 std::string print(OperatorType operator_type);
 std::string print(
-  std::shared_ptr<Expression> expression, std::string::size_type indent = 0);
\ No newline at end of file
+  const std::shared_ptr<Expression>& expression,
+  std::string::size_type indent = 0);
+
+/*
+  Converts the package into the same textual representation as print, but
+  without the statements of its functions, so that lazily parsed function
+  bodies are not loaded.
+*/
+std::string print_summary(const std::shared_ptr<Package>& package);
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  A bounded queue for passing values from one producer thread to one consumer
+  thread without locks, used to run compiler phases as a pipeline. The producer
+  only writes the tail index and the consumer only writes the head index, so
+  each index has a single writer, and the values in the slots are published by
+  the release and acquire ordering of the indices.
+
+  A full queue blocks the producer, and an empty queue blocks the consumer, so
+  a fast phase cannot run arbitrarily far ahead of a slow one. Blocked threads
+  yield rather than sleep, since pipeline phases are expected to keep up with
+  each other.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Passes values from one thread to another, in order
+template<typename T> class SpscRing {
+public:
+  // The ring holds at most capacity values that have not been popped
+  explicit SpscRing(std::size_t capacity): slots_(capacity) {}
+
+  // Not copyable or assignable
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Adds value to the back, waiting while the ring is full (producer only)
+  void push(T value);
+
+  // Removes the front value, waiting while the ring is empty (consumer only)
+  T pop();
+
+private:
+  std::vector<T> slots_;
+  // Counts of popped and pushed values, whose remainders by the capacity are
+  // the slots of the front value and of the next value to push
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+template<typename T>
+void SpscRing<T>::push(T value) {
+  std::size_t tail = tail_.load(std::memory_order_relaxed);
+  while (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+    std::this_thread::yield();
+  }
+  slots_[tail % slots_.size()] = std::move(value);
+  tail_.store(tail + 1, std::memory_order_release);
+}
+
+template<typename T>
+T SpscRing<T>::pop() {
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  while (tail_.load(std::memory_order_acquire) == head) {
+    std::this_thread::yield();
+  }
+  T value = std::move(slots_[head % slots_.size()]);
+  head_.store(head + 1, std::memory_order_release);
+  return value;
+}
@@ -0,0 +1,66 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "symbol_table.h"
+
+Symbol SymbolInterner::intern(std::string_view name) {
+  auto iter = symbols_.find(name);
+  if (iter != symbols_.cend()) return iter->second;
+  Symbol symbol = static_cast<Symbol>(names_.size());
+  const std::string& stored = names_.emplace_back(name);
+  symbols_.emplace(stored, symbol);
+  return symbol;
+}
+
+std::optional<Symbol> SymbolInterner::find(std::string_view name) const {
+  auto iter = symbols_.find(name);
+  if (iter == symbols_.cend()) return std::nullopt;
+  return iter->second;
+}
+
+SymbolTable::SymbolTable(): scopes_(1) {}
+
+void SymbolTable::enter_scope() {
+  scopes_.emplace_back();
+}
+
+void SymbolTable::exit_scope() {
+  for (Symbol symbol : scopes_.back()) {
+    bindings_[symbol].pop_back();
+  }
+  scopes_.pop_back();
+}
+
+bool SymbolTable::bind(std::string_view name, std::shared_ptr<Entity> entity) {
+  Symbol symbol = interner_.intern(name);
+  std::vector<Binding>& bindings = bindings_[symbol];
+  std::size_t scope = scopes_.size() - 1;
+  if (!bindings.empty() && bindings.back().scope == scope) return false;
+  bindings.push_back(Binding{std::move(entity), scope});
+  scopes_.back().push_back(symbol);
+  return true;
+}
+
+std::shared_ptr<Entity> SymbolTable::lookup(std::string_view name) const {
+  std::optional<Symbol> symbol = interner_.find(name);
+  if (symbol) {
+    auto iter = bindings_.find(*symbol);
+    if (iter != bindings_.cend() && !iter->second.empty()) {
+      return iter->second.back().entity;
+    }
+  }
+  return outer_ ? outer_->lookup(name) : nullptr;
+}
@@ -0,0 +1,121 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  The symbol table maps names to the entities they refer to while the graph is
+  being built, taking nested scopes into account. Names declared in an inner
+  scope hide the same names declared in outer scopes, until the inner scope is
+  exited.
+
+  Names are interned into symbols, and each symbol maps to a stack of the
+  bindings currently visible for it, innermost last. Looking up a name is a
+  single hash table lookup regardless of how deeply scopes are nested, and
+  exiting a scope only touches the bindings made in that scope.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "graph.h"
+
+// An interned name. Equal names are always interned to the same symbol.
+using Symbol = std::uint32_t;
+
+// Assigns a unique symbol to each distinct name
+class SymbolInterner {
+public:
+  // Returns the symbol for name, assigning a new symbol if necessary
+  Symbol intern(std::string_view name);
+
+  // Returns the symbol for name, or nothing if name was never interned
+  std::optional<Symbol> find(std::string_view name) const;
+
+  // Returns the name that was interned to symbol
+  const std::string& name(Symbol symbol) const { return names_[symbol]; }
+
+private:
+  // Names are stored in a deque so that the keys of symbols_ remain valid
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, Symbol> symbols_;
+};
+
+// Maps names to entities within a stack of nested scopes
+class SymbolTable {
+public:
+  // The table starts with a single outermost scope
+  SymbolTable();
+
+  // Enters a new innermost scope
+  void enter_scope();
+
+  // Exits the innermost scope, removing all of the bindings made in it
+  void exit_scope();
+
+  // Number of scopes currently entered, including the outermost scope
+  std::size_t depth() const { return scopes_.size(); }
+
+  /*
+    Binds name to entity in the innermost scope, hiding any bindings of the
+    same name in outer scopes. Returns false without binding if the name is
+    already bound in the innermost scope.
+  */
+  bool bind(std::string_view name, std::shared_ptr<Entity> entity);
+
+  /*
+    Returns the entity bound to name in the innermost scope that binds it, or
+    nullptr if the name is not bound in any scope.
+  */
+  std::shared_ptr<Entity> lookup(std::string_view name) const;
+
+  /*
+    Sets a table that names are looked up in when they are not bound in any
+    scope of this table, such as the index of names declared at the top level
+    of a package. The outer table is only read, so it may be shared by tables
+    on different threads as long as it is no longer modified.
+  */
+  void set_outer(std::shared_ptr<const SymbolTable> outer) {
+    outer_ = std::move(outer);
+  }
+
+  /*
+    Returns the entity bound to name if it is of type EntityT, or nullptr if
+    the name is unbound or bound to a different type of entity.
+  */
+  template<typename EntityT>
+  std::shared_ptr<EntityT> lookup_as(std::string_view name) const {
+    return std::dynamic_pointer_cast<EntityT>(lookup(name));
+  }
+
+private:
+  struct Binding {
+    std::shared_ptr<Entity> entity;
+    // Index of the scope that made the binding
+    std::size_t scope;
+  };
+
+  SymbolInterner interner_;
+  std::unordered_map<Symbol, std::vector<Binding>> bindings_;
+  // Symbols bound in each scope, outermost first
+  std::vector<std::vector<Symbol>> scopes_;
+  std::shared_ptr<const SymbolTable> outer_;
+};
@@ -0,0 +1,80 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Regression benchmark for deeply nested expressions. Generates a function
+# returning an expression nested DEPTH levels deep, "((argc + 1) + 1) ...",
+# compiles it with veil in the given MODE, and fails if the compiler fails or
+# takes longer than LIMIT seconds.
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR -DMODE=MODE [-DDEPTH=N] [-DLIMIT=S]
+#   -P deep_expression.cmake
+# Modes:
+#   print      Prints the tokens, the graph and the C code (the default output)
+#   translate  Writes the C code to an output directory
+#   fold       Folds constants, then writes the C code to an output directory
+
+if(NOT DEFINED DEPTH)
+  set(DEPTH 100000)
+endif()
+if(NOT DEFINED LIMIT)
+  set(LIMIT 30)
+endif()
+
+# Repeat the opening and closing text DEPTH times, by repeated doubling
+set(open "(")
+set(close " + 1)")
+set(opens "")
+set(closes "")
+set(count ${DEPTH})
+while(count GREATER 0)
+  math(EXPR bit "${count} % 2")
+  if(bit)
+    string(APPEND opens "${open}")
+    string(APPEND closes "${close}")
+  endif()
+  string(APPEND open "${open}")
+  string(APPEND close "${close}")
+  math(EXPR count "${count} / 2")
+endwhile()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(input ${WORK_DIR}/deep_${DEPTH}.v)
+file(WRITE ${input}
+  "func main (int argc) -> int {\n  return ${opens}argc${closes};\n}\n")
+
+if(MODE STREQUAL "print")
+  set(arguments)
+elseif(MODE STREQUAL "translate")
+  set(arguments --output-dir ${WORK_DIR}/${MODE})
+elseif(MODE STREQUAL "fold")
+  set(arguments --pass fold-constants --output-dir ${WORK_DIR}/${MODE})
+else()
+  message(FATAL_ERROR "unknown mode ${MODE}")
+endif()
+
+string(TIMESTAMP start "%s")
+execute_process(
+  COMMAND ${VEIL} ${arguments} ${input}
+  OUTPUT_FILE ${WORK_DIR}/${MODE}.out
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE result)
+string(TIMESTAMP end "%s")
+math(EXPR seconds "${end} - ${start}")
+message(STATUS "${MODE}, depth ${DEPTH}: ${seconds} s")
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "veil failed (${result}):\n${errors}")
+endif()
+if(seconds GREATER LIMIT)
+  message(FATAL_ERROR "took ${seconds} s, more than the limit of ${LIMIT} s")
+endif()
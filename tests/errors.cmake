@@ -0,0 +1,67 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+# Checks the errors reported for a program that veil must reject. Runs veil on
+# SAMPLE, and fails unless it exits with a failure rather than crashing, and
+# reports exactly the errors that the sample expects. The sample lists them,
+# and the arguments to run veil with, in comments at its top:
+#   // arguments: ARGS             Arguments placed before the sample, if any
+#   // error: LINE:COLUMN: TEXT    An error reported at LINE and COLUMN
+#
+# Usage: cmake -DVEIL=PATH -DSAMPLE=FILE -P errors.cmake
+
+file(STRINGS ${SAMPLE} directives REGEX "^// (arguments|error): ")
+
+set(options "")
+set(expected 0)
+foreach(directive ${directives})
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\1" kind "${directive}")
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\2" text "${directive}")
+  if(kind STREQUAL "arguments")
+    separate_arguments(options UNIX_COMMAND "${text}")
+  else()
+    math(EXPR expected "${expected} + 1")
+  endif()
+endforeach()
+
+execute_process(
+  COMMAND ${VEIL} ${options} ${SAMPLE}
+  OUTPUT_QUIET
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 1)
+  message(FATAL_ERROR "expected veil to fail, but it exited with ${result}:\n"
+    "${errors}")
+endif()
+
+foreach(directive ${directives})
+  string(REGEX REPLACE "^// ([a-z]+): ([0-9]+:[0-9]+): (.*)$" "\\1" kind
+    "${directive}")
+  if(kind STREQUAL "error")
+    string(REGEX REPLACE "^// ([a-z]+): ([0-9]+:[0-9]+): (.*)$"
+      "${SAMPLE}:\\2: error: \\3" text "${directive}")
+    string(FIND "${errors}" "${text}" position)
+    if(position EQUAL -1)
+      message(FATAL_ERROR "missing \"${text}\" in:\n${errors}")
+    endif()
+  endif()
+endforeach()
+string(REGEX MATCHALL ": error: " reported "${errors}")
+list(LENGTH reported count)
+if(NOT count EQUAL expected)
+  message(FATAL_ERROR "expected ${expected} errors, but got ${count}:\n"
+    "${errors}")
+endif()
@@ -0,0 +1,32 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// With lazily parsed bodies, calls with the wrong number of arguments are only
+// reported after precomputing, which must not evaluate them
+// arguments: --lazy --pass precompute
+// error: 28:40: function "g" takes 1 arguments, but 10 were given
+// error: 28:46: function "g" takes 1 arguments, but 0 were given
+
+func g (int x) -> int {
+  return x;
+}
+@precomputed
+func f (int x) -> int {
+  return g(x, 1, 2, 3, 4, 5, 6, 7, 8, 9) + g();
+}
+func main (int argc) -> int {
+  return f(2);
+}
@@ -0,0 +1,34 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// The parser recovers from each error, so one run reports all of them
+// error: 24:16: unexpected ";"
+// error: 27:10: unknown object "missing"
+// error: 30:12: unexpected "$"
+// error: 32:13: unknown class "unknown"
+
+func main (int argc) -> int {
+  return argc +;
+}
+func first (int x) -> int {
+  return missing(x);
+}
+func second (int x) -> int {
+  return x $ 1;
+}
+func third (unknown x) -> int {
+  return x;
+}
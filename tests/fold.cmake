@@ -0,0 +1,84 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+# Compares a program compiled with and without constant folding. Compiles and
+# runs SAMPLE both ways, and fails unless both executables exit with the code
+# that the sample expects. The C code is compiled with the undefined behavior
+# sanitizer, so an int overflow that folding introduces makes the program fail
+# even where the C compiler would otherwise wrap around. The sample lists the
+# expected code, and text of the C code, in comments at its top:
+#   // exit: CODE   The exit code of the program run without arguments
+#   // keeps: TEXT  Text that the folded C code must still contain, such as an
+#                   operation whose behavior is undefined in C
+#   // drops: TEXT  Text of the unfolded C code that folding must remove
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR -DSAMPLE=FILE -P fold.cmake
+
+get_filename_component(name ${SAMPLE} NAME_WE)
+set(root ${WORK_DIR}/fold/${name})
+file(REMOVE_RECURSE ${root})
+file(STRINGS ${SAMPLE} directives REGEX "^// (exit|keeps|drops): ")
+
+foreach(variant plain folded)
+  set(arguments --output-dir ${root}/${variant} --build
+    --cflags "-O2 -fsanitize=undefined -fno-sanitize-recover=all"
+    --ldflags -fsanitize=undefined)
+  if(variant STREQUAL "folded")
+    list(APPEND arguments --pass fold-constants)
+  endif()
+  execute_process(
+    COMMAND ${VEIL} ${arguments} ${SAMPLE}
+    OUTPUT_QUIET
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "compiling ${variant} failed (${result}):\n${errors}")
+  endif()
+  execute_process(
+    COMMAND ${root}/${variant}/default
+    RESULT_VARIABLE ${variant}_exit)
+
+  set(${variant}_code "")
+  file(GLOB sources ${root}/${variant}/*.c)
+  foreach(source ${sources})
+    file(READ ${source} code)
+    string(APPEND ${variant}_code "${code}")
+  endforeach()
+endforeach()
+
+foreach(directive ${directives})
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\1" kind "${directive}")
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\2" text "${directive}")
+  string(FIND "${folded_code}" "${text}" folded_position)
+  if(kind STREQUAL "exit")
+    if(NOT plain_exit STREQUAL text OR NOT folded_exit STREQUAL text)
+      message(FATAL_ERROR "expected exit code ${text}, but the program exited "
+        "with ${plain_exit} unfolded and ${folded_exit} folded")
+    endif()
+  elseif(kind STREQUAL "keeps")
+    if(folded_position EQUAL -1)
+      message(FATAL_ERROR "folded C code lacks \"${text}\":\n${folded_code}")
+    endif()
+  elseif(kind STREQUAL "drops")
+    string(FIND "${plain_code}" "${text}" plain_position)
+    if(plain_position EQUAL -1)
+      message(FATAL_ERROR "unfolded C code lacks \"${text}\":\n${plain_code}")
+    endif()
+    if(NOT folded_position EQUAL -1)
+      message(FATAL_ERROR
+        "folded C code still has \"${text}\":\n${folded_code}")
+    endif()
+  endif()
+endforeach()
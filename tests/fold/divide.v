@@ -0,0 +1,35 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Division and modulo by zero are left for the C code to compute, and other
+// divisions round towards zero as in C
+// exit: 13
+// keeps: (a/0)
+// keeps: (a%0)
+// keeps: (a/=0)
+// keeps: ((1/0)+(7%0))
+// drops: (0-7)
+
+func divides (int a) -> int {
+  a / 0;
+  a % 0;
+  a /= 0;
+  return 1 / 0 + 7 % 0;
+}
+func main (int argc) -> int {
+  return (0 - 7) / 2 * 10 + (0 - 7) % 2 + 7 / 2 + argc / 1 +
+    0 / (argc + 1) + 40;
+}
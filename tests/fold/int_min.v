@@ -0,0 +1,34 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// The smallest int is folded and written so that the C code reads it as an
+// int, and dividing it by -1, which overflows, is left for the C code
+// exit: 15
+// keeps: ((-2147483647-1)/(-1))
+// keeps: ((-2147483647-1)%(-1))
+// drops: (0-1073741824)
+
+func unsafe (int a) -> int {
+  (0 - 2147483647 - 1) / (0 - 1);
+  return (0 - 2147483647 - 1) % (0 - 1);
+}
+func main (int argc) -> int {
+  argc = 0 - 2147483647 - argc;
+  return (argc == 0 - 2147483647 - 1) +
+    ((0 - 2147483647 - 1) / 2 == 0 - 1073741824) * 2 +
+    ((0 - 2147483647 - 1) % 3 == 0 - 2) * 4 +
+    ((0 - 2147483647 - 1) + 1 + 2147483647 == 0) * 8;
+}
@@ -0,0 +1,36 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Operations that overflow an int are left for the C code to compute, while
+// the integers of chains that do not overflow are still combined
+// exit: 9
+// keeps: (a*2147483647*2)
+// keeps: ((2147483647*2)+a)
+// keeps: (a+2147483647+1)
+// keeps: return (2147483647+1);
+// drops: (1000000*2000)
+
+func overflows (int a) -> int {
+  a * 2147483647 * 2;
+  2147483647 * 2 + a;
+  a + 2147483647 + 1;
+  return 2147483647 + 1;
+}
+func main (int argc) -> int {
+  argc = argc + 2147483646 - 2147483646;
+  return 2147483647 - 2147483646 + 2147483646 - 2147483640 +
+    argc * (65536 - 65535) + 1000000 * 2000 - 1999999999;
+}
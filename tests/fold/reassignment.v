@@ -0,0 +1,44 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Constants are propagated through objects until they are assigned a value
+// that is not known, such as the result of a call
+// exit: 227
+// keeps: (a=(a+1))
+// keeps: (b=(17-a))
+// drops: (a=(a*4))
+// drops: (b=(a+1))
+
+func twice (int a) -> int {
+  return a * 2;
+}
+func run (int a, int b) -> int {
+  a = 3;
+  a = a * 4;
+  a += 5;
+  a -= 1;
+  b = a + 1;
+  a = twice(b + a);
+  a = a + 1;
+  b = b - a;
+  a = 10;
+  a /= 3;
+  a %= 2;
+  return a + twice(a) * 10 + b;
+}
+func main (int argc) -> int {
+  return run(argc, argc);
+}
@@ -0,0 +1,34 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Integers are not moved past other operands of + and - chains, since the
+// reordered chain has intermediate results of its own, which may overflow where
+// the original ones do not
+// exit: 5
+// keeps: (a+5+b+5+c)
+// keeps: (a-5-b-5)
+// drops: (a+2+3+b+5+c)
+
+func add (int a, int b, int c) -> int {
+  return a + 2 + 3 + b + 5 + c;
+}
+func subtract (int a, int b) -> int {
+  return a - 5 - b - 5;
+}
+func main (int argc) -> int {
+  return add(0 - 2147483645, 0 - 3, 0 - 3) + subtract(2147483640, 0 - 10) +
+    argc + 5;
+}
@@ -0,0 +1,35 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// x*0 is only folded to 0 when evaluating x has no side effects
+// exit: 7
+// keeps: ((argc=5)*0)
+// keeps: ((argc+=2)*0)
+// keeps: (next(argc)*0)
+// keeps: (0*next(argc))
+// drops: (argc*0)
+
+func next (int a) -> int {
+  return a + 1;
+}
+func main (int argc) -> int {
+  (argc = 5) * 0;
+  (argc += 2) * 0 * 3;
+  next(argc) * 0;
+  0 * next(argc);
+  argc * 0;
+  return argc;
+}
@@ -0,0 +1,184 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Tests that structurally identical graphs hash equal, that graphs which
+  differ hash differently, and that editing a graph in place discards the
+  cached hashes of the edited entity's ancestors.
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "graph.h"
+#include "hasher.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& description) {
+  if (!condition) {
+    std::cerr << "FAILED: " << description << "\n";
+    ++failures;
+  }
+}
+
+/*
+  The entities of "func NAME (int a, int b) -> int { a OPERATOR b; return
+  a OPERATOR b; }", in a package of its own
+*/
+struct Graph {
+  std::shared_ptr<Package> package;
+  std::shared_ptr<Function> function;
+  std::shared_ptr<OperatorExpression> statement;
+  std::shared_ptr<ReturnStatement> return_statement;
+};
+
+std::shared_ptr<OperatorExpression> make_operator(OperatorType operator_type,
+  const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& right)
+{
+  auto expression = std::make_shared<OperatorExpression>();
+  expression->set_operator_type(operator_type);
+  for (const auto& object : {left, right}) {
+    auto object_expression = std::make_shared<ObjectExpression>();
+    object_expression->set_object(object);
+    expression->add(object_expression);
+  }
+  return expression;
+}
+
+Graph make_graph(const std::string& name, OperatorType operator_type) {
+  Graph graph;
+  graph.package = std::make_shared<Package>();
+  graph.package->set_name("default");
+  auto int_class = std::make_shared<Class>();
+  int_class->set_name("int");
+  graph.package->add(int_class);
+
+  graph.function = std::make_shared<Function>();
+  graph.function->set_name(name);
+  graph.function->set_return_type(ReturnType::value);
+  graph.function->set_return_class(int_class);
+  std::shared_ptr<Object> objects[2];
+  for (int i = 0; i < 2; ++i) {
+    objects[i] = std::make_shared<Object>();
+    objects[i]->set_name(i == 0 ? "a" : "b");
+    objects[i]->set_cls(int_class);
+    graph.function->add(objects[i]);
+  }
+  graph.statement = make_operator(operator_type, objects[0], objects[1]);
+  graph.function->add(graph.statement);
+  graph.return_statement = std::make_shared<ReturnStatement>();
+  graph.return_statement->set_expression(
+    make_operator(operator_type, objects[0], objects[1]));
+  graph.function->add(graph.return_statement);
+  graph.package->add(graph.function);
+  return graph;
+}
+
+// The operator expression returned by the function
+OperatorExpression& returned(const Graph& graph) {
+  return static_cast<OperatorExpression&>(
+    *graph.return_statement->expression());
+}
+
+void test_identical_graphs() {
+  Graph first = make_graph("sum", OperatorType::plus);
+  Graph second = make_graph("sum", OperatorType::plus);
+  check(hash(*first.package) == hash(*second.package),
+    "identical packages hash equal");
+  check(hash(*first.function) == hash(*second.function),
+    "identical functions hash equal");
+}
+
+void test_different_graphs() {
+  Graph sum = make_graph("sum", OperatorType::plus);
+  check(hash(*sum.function) !=
+    hash(*make_graph("sum", OperatorType::minus).function),
+    "functions with different operators hash differently");
+  check(hash(*sum.function) !=
+    hash(*make_graph("add", OperatorType::plus).function),
+    "functions with different names hash differently");
+}
+
+void test_edit_under_return() {
+  Graph graph = make_graph("sum", OperatorType::plus);
+  std::uint64_t before = hash(*graph.package);
+  std::uint64_t function_before = hash(*graph.function);
+  returned(graph).set_operator_type(OperatorType::minus);
+  check(hash(*graph.function) != function_before,
+    "editing a returned expression rehashes the function");
+  check(hash(*graph.package) != before,
+    "editing a returned expression rehashes the package");
+
+  // Editing back restores the original hash
+  returned(graph).set_operator_type(OperatorType::plus);
+  check(hash(*graph.package) == before,
+    "reverting an edit restores the hash");
+}
+
+void test_edit_statement() {
+  Graph graph = make_graph("sum", OperatorType::plus);
+  std::uint64_t before = hash(*graph.function);
+  graph.statement->set_operator_type(OperatorType::multiply);
+  check(hash(*graph.function) != before,
+    "editing an expression statement rehashes the function");
+}
+
+void test_replaced_expression() {
+  Graph graph = make_graph("sum", OperatorType::plus);
+  std::uint64_t before = hash(*graph.function);
+
+  // Replace the returned expression, then edit the replacement in place
+  const auto& objects = graph.function->object_entities();
+  auto replacement =
+    make_operator(OperatorType::plus, objects[0], objects[1]);
+  graph.return_statement->set_expression(replacement);
+  check(hash(*graph.function) == before,
+    "replacing an expression with an identical one keeps the hash");
+  replacement->set_operator_type(OperatorType::minus);
+  check(hash(*graph.function) != before,
+    "editing a replacement expression rehashes the function");
+}
+
+void test_missing_expression() {
+  // Recovering from a parse error may leave a return without expression
+  Graph first = make_graph("sum", OperatorType::plus);
+  Graph second = make_graph("sum", OperatorType::plus);
+  std::uint64_t before = hash(*first.function);
+  first.return_statement->set_expression(nullptr);
+  second.return_statement->set_expression(nullptr);
+  check(hash(*first.function) != before,
+    "removing a returned expression rehashes the function");
+  check(hash(*first.function) == hash(*second.function),
+    "returns without expression hash equal");
+}
+
+}  // namespace
+
+int main() {
+  test_identical_graphs();
+  test_different_graphs();
+  test_edit_under_return();
+  test_edit_statement();
+  test_replaced_expression();
+  test_missing_expression();
+  if (failures) return EXIT_FAILURE;
+  std::cout << "all hasher tests passed\n";
+  return EXIT_SUCCESS;
+}
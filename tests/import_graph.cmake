@@ -0,0 +1,91 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Regression test for loading a deep and wide import graph in parallel.
+# Generates a chain of packages p0 <- p1 <- ... <- pN, where every package
+# also imports the package d, and a package app that imports all of them. The
+# graph is then loaded with each of JOBS worker threads, and each load must
+# finish within LIMIT seconds. Every package also defines a private class and a
+# private function of the same names, which must not collide in the C code, so
+# the graph is finally built into an executable, which must return the sum
+# computed across the packages.
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR [-DLENGTH=N] [-DJOBS=1;2;...]
+#   [-DLIMIT=S] -P import_graph.cmake
+
+if(NOT DEFINED LENGTH)
+  set(LENGTH 12)
+endif()
+if(NOT DEFINED JOBS)
+  set(JOBS 1 2 3 4 8)
+endif()
+if(NOT DEFINED LIMIT)
+  set(LIMIT 10)
+endif()
+
+set(root ${WORK_DIR}/import_graph)
+file(REMOVE_RECURSE ${root})
+# Private to each package, returning 1 except in app, where it returns 3
+set(private "class item {}\nfunc helper () -> int {\n  return 1;\n}\n")
+file(WRITE ${root}/d/d.v
+  "package d;\n${private}pub func dv () -> int {\n  return 1;\n}\n")
+set(app "package app;\n")
+math(EXPR last "${LENGTH} - 1")
+foreach(i RANGE ${last})
+  set(source "package p${i};\nimport d.dv;\n")
+  if(i EQUAL 0)
+    string(APPEND source "${private}"
+      "pub func f0 () -> int {\n  return dv() + helper();\n}\n")
+  else()
+    math(EXPR previous "${i} - 1")
+    string(APPEND source "import p${previous}.f${previous};\n${private}"
+      "pub func f${i} () -> int {\n"
+      "  return dv() + f${previous}() + helper();\n}\n")
+  endif()
+  file(WRITE ${root}/p${i}/p.v "${source}")
+  string(APPEND app "import p${i}.f${i};\n")
+endforeach()
+string(APPEND app
+  "class item {}\nfunc helper () -> int {\n  return 3;\n}\n"
+  "func main (int argc) -> int {\n  return f${last}() + helper();\n}\n")
+file(WRITE ${root}/app/app.v "${app}")
+
+foreach(jobs ${JOBS})
+  execute_process(
+    COMMAND ${VEIL} --summary --jobs ${jobs} ${root}/app
+    OUTPUT_QUIET
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result
+    TIMEOUT ${LIMIT})
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "loading with --jobs ${jobs} failed (${result}):\n"
+      "${errors}")
+  endif()
+endforeach()
+
+# Each package p0 ... pN adds 2 and app adds 3, modulo the 8-bit exit status
+execute_process(
+  COMMAND ${VEIL} --output-dir ${root}/out --build ${root}/app
+  OUTPUT_QUIET
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE result
+  TIMEOUT ${LIMIT})
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "building failed (${result}):\n${errors}")
+endif()
+math(EXPR expected "(${LENGTH} * 2 + 3) % 256")
+execute_process(COMMAND ${root}/out/app RESULT_VARIABLE result)
+if(NOT result EQUAL expected)
+  message(FATAL_ERROR "app returned ${result} instead of ${expected}")
+endif()
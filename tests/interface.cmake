@@ -0,0 +1,60 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+# Regression test for compiling packages separately through their interfaces.
+# Compiles a package base on its own, writing its interface and C code, and
+# then a package app that uses its classes and functions, loading base from
+# its interface. The C code of app must declare what it uses from base, and
+# --build must link the objects of base, so that the executable returns the
+# value computed by base.
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR -P interface.cmake
+
+set(root ${WORK_DIR}/interface)
+file(REMOVE_RECURSE ${root})
+file(WRITE ${root}/base/base.v
+  "package base;\n"
+  "pub class num {}\n"
+  "pub func three () -> int {\n  return 3;\n}\n"
+  "pub func id (num x) -> num {\n  return x;\n}\n")
+file(WRITE ${root}/app/app.v
+  "package app;\n"
+  "import base.num;\n"
+  "import base.three;\n"
+  "import base.id;\n"
+  "func keep (num x) -> num {\n  return id(x);\n}\n"
+  "func main (int argc) -> int {\n  return three() + 4;\n}\n")
+
+set(options --interface-dir ${root}/interfaces --output-dir ${root}/out
+  --cflags "-O2 -Werror=implicit-function-declaration")
+foreach(package base app)
+  set(arguments ${options})
+  if(package STREQUAL "app")
+    list(APPEND arguments --build)
+  endif()
+  execute_process(
+    COMMAND ${VEIL} ${arguments} ${root}/${package}
+    OUTPUT_QUIET
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "compiling ${package} failed (${result}):\n${errors}")
+  endif()
+endforeach()
+
+execute_process(COMMAND ${root}/out/app RESULT_VARIABLE result)
+if(NOT result EQUAL 7)
+  message(FATAL_ERROR "app returned ${result} instead of 7")
+endif()
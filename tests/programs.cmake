@@ -0,0 +1,63 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+# Builds and runs a program that veil must accept. Compiles SAMPLE with --build,
+# and fails unless the program exits with the code that the sample expects,
+# and veil prints the expected text. The sample lists them in comments at its
+# top:
+#   // exit: CODE    The exit code of the program run without arguments
+#   // prints: TEXT  Text that veil must print, such as part of the C code
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR -DSAMPLE=FILE -P programs.cmake
+
+get_filename_component(name ${SAMPLE} NAME_WE)
+set(root ${WORK_DIR}/programs/${name})
+file(REMOVE_RECURSE ${root})
+file(STRINGS ${SAMPLE} directives REGEX "^// (exit|prints): ")
+
+execute_process(
+  COMMAND ${VEIL} --output-dir ${root} --build ${SAMPLE}
+  OUTPUT_QUIET
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "compiling failed (${result}):\n${errors}")
+endif()
+execute_process(COMMAND ${root}/default RESULT_VARIABLE exit)
+# The C code is only printed when it is not written to files
+execute_process(
+  COMMAND ${VEIL} ${SAMPLE}
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE errors
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "printing failed (${result}):\n${errors}")
+endif()
+
+foreach(directive ${directives})
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\1" kind "${directive}")
+  string(REGEX REPLACE "^// ([a-z]+): (.*)$" "\\2" text "${directive}")
+  if(kind STREQUAL "exit")
+    if(NOT exit STREQUAL text)
+      message(FATAL_ERROR "expected exit code ${text}, but got ${exit}")
+    endif()
+  else()
+    string(FIND "${output}" "${text}" position)
+    if(position EQUAL -1)
+      message(FATAL_ERROR "missing \"${text}\" in:\n${output}")
+    endif()
+  endif()
+endforeach()
@@ -0,0 +1,34 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Functions and classes may be used before they are defined
+// exit: 8
+// prints: static int first(int x);
+// prints: static int second(int x);
+
+func main (int argc) -> int {
+  return first(argc) + 4;
+}
+func first (int x) -> int {
+  return second(x) * 2;
+}
+func keep (later x) -> later {
+  return x;
+}
+func second (int x) -> int {
+  return x + 1;
+}
+class later {}
@@ -0,0 +1,31 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Operators bind by precedence, binary operators associate to the left and
+// assignments to the right, and chains of one operator become one operation
+// exit: 8
+// prints: (a=(b=c));
+// prints: (a-=(b-=1));
+// prints: return ((((a-b-c)+((a*b)%c))-(((a-1)*(b+c))/2))+10);
+
+func main (int argc) -> int {
+  return mix(argc, 2, 3);
+}
+func mix (int a, int b, int c) -> int {
+  a = b = c;
+  a -= b -= 1;
+  return a - b - c + a * b % c - (a - 1) * (b + c) / 2 + 10;
+}
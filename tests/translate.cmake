@@ -0,0 +1,251 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+# Checks how functions are laid out in the C code. Generates a program calling
+# a chain of private functions f0 ... fN, and:
+#   - translates it with one and with several worker threads, into standard
+#     output and into SHARDS source files, which must give identical C code;
+#   - checks that callees are defined before their callers in each file;
+#   - checks that private functions are static, and static inline when small,
+#     unless called from another shard, and only then declared in the header;
+#   - edits one function, which must only change the source file defining it;
+#   - builds the program into one and into SHARDS source files, which must
+#     both return the same value.
+#
+# Usage: cmake -DVEIL=PATH -DWORK_DIR=DIR [-DLENGTH=N] [-DSHARDS=N]
+#   [-DJOBS=N] -P translate.cmake
+
+if(NOT DEFINED LENGTH)
+  set(LENGTH 8)
+endif()
+if(NOT DEFINED SHARDS)
+  set(SHARDS 3)
+endif()
+if(NOT DEFINED JOBS)
+  set(JOBS 4)
+endif()
+
+set(root ${WORK_DIR}/translate)
+file(REMOVE_RECURSE ${root})
+math(EXPR last "${LENGTH} - 1")
+
+# Pairs of caller and callee, and the functions that are public
+set(calls main:shared main:twice main:f${last} shared:large large:twice)
+set(public main shared)
+set(functions main shared large twice)
+string(CONCAT source
+  "func main (int argc) -> int {\n"
+  "  return shared(argc) + twice(3) + f${last}(argc);\n}\n"
+  "pub func shared (int x) -> int {\n  return large(x) + 1;\n}\n"
+  "func large (int x) -> int {\n"
+  "  x += 1;\n  x += 2;\n  x += 3;\n  return twice(x);\n}\n"
+  "func twice (int x) -> int {\n  return x * 2;\n}\n")
+foreach(i RANGE ${last})
+  list(APPEND functions f${i})
+  if(i EQUAL 0)
+    string(APPEND source "func f0 (int x) -> int {\n  return x + 0;\n}\n")
+  else()
+    math(EXPR previous "${i} - 1")
+    list(APPEND calls f${i}:f${previous})
+    string(APPEND source
+      "func f${i} (int x) -> int {\n  return f${previous}(x) + ${i};\n}\n")
+  endif()
+endforeach()
+file(WRITE ${root}/main.v "${source}")
+# Changes the constant of f1 only, without changing its size
+string(REPLACE "f0(x) + 1;" "f0(x) + 9;" edited "${source}")
+file(WRITE ${root}/edited/main.v "${edited}")
+
+function(run_veil output)
+  execute_process(
+    COMMAND ${VEIL} ${ARGN}
+    OUTPUT_VARIABLE stdout
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "veil ${ARGN} failed (${result}):\n${errors}")
+  endif()
+  set(${output} "${stdout}" PARENT_SCOPE)
+endfunction()
+
+# Position of the definition of function in code, or -1, and its linkage
+function(find_definition code name position linkage)
+  string(REGEX MATCH "\n(static (inline )?)?int ${name}\\(int [a-z]+\\) {"
+    definition "${code}")
+  if(definition STREQUAL "")
+    set(${position} -1 PARENT_SCOPE)
+    return()
+  endif()
+  string(FIND "${code}" "${definition}" found)
+  string(REGEX REPLACE "int .*$" "" kind "${definition}")
+  string(STRIP "${kind}" kind)
+  set(${position} ${found} PARENT_SCOPE)
+  set(${linkage} "${kind}" PARENT_SCOPE)
+endfunction()
+
+# Fails unless each callee defined in code is defined before its callers
+function(check_order code description)
+  foreach(call ${calls})
+    string(REPLACE ":" ";" pair ${call})
+    list(GET pair 0 caller)
+    list(GET pair 1 callee)
+    find_definition("${code}" ${caller} caller_position linkage)
+    find_definition("${code}" ${callee} callee_position linkage)
+    if(NOT caller_position EQUAL -1 AND NOT callee_position EQUAL -1 AND
+      callee_position GREATER caller_position)
+      message(FATAL_ERROR
+        "${callee} is defined after its caller ${caller} in ${description}:\n"
+        "${code}")
+    endif()
+  endforeach()
+endfunction()
+
+# Translating in parallel gives the same code as translating serially
+run_veil(serial --jobs 1 ${root}/main.v)
+run_veil(parallel --jobs ${JOBS} ${root}/main.v)
+if(NOT serial STREQUAL parallel)
+  message(FATAL_ERROR "--jobs 1 and --jobs ${JOBS} differ:\n${serial}\n"
+    "----------\n${parallel}")
+endif()
+string(FIND "${serial}" "----------C Code----------" start)
+string(SUBSTRING "${serial}" ${start} -1 code)
+check_order("${code}" "the C code")
+foreach(name ${functions})
+  find_definition("${code}" ${name} position linkage)
+  if(position EQUAL -1)
+    message(FATAL_ERROR "${name} is not defined:\n${code}")
+  endif()
+  list(FIND public ${name} public_index)
+  if(NOT public_index EQUAL -1)
+    set(expected "")
+  elseif(name STREQUAL "large")
+    set(expected "static")
+  else()
+    set(expected "static inline")
+  endif()
+  if(NOT linkage STREQUAL expected)
+    message(FATAL_ERROR
+      "${name} is \"${linkage}\" instead of \"${expected}\":\n${code}")
+  endif()
+endforeach()
+
+# Reads the header and source files written to directory into the variables
+# prefix_header and prefix_0 ... prefix_N, since C code cannot be in a list
+math(EXPR last_shard "${SHARDS} - 1")
+function(read_shards directory prefix)
+  file(READ ${directory}/default.h header)
+  set(${prefix}_header "${header}" PARENT_SCOPE)
+  foreach(shard RANGE ${last_shard})
+    file(READ ${directory}/default_${shard}.c code)
+    set(${prefix}_${shard} "${code}" PARENT_SCOPE)
+  endforeach()
+endfunction()
+
+foreach(jobs 1 ${JOBS})
+  run_veil(stdout --jobs ${jobs} --shards ${SHARDS}
+    --output-dir ${root}/jobs${jobs} ${root}/main.v)
+  read_shards(${root}/jobs${jobs} jobs${jobs})
+endforeach()
+set(parts header)
+foreach(shard RANGE ${last_shard})
+  list(APPEND parts ${shard})
+endforeach()
+foreach(part ${parts})
+  if(NOT jobs1_${part} STREQUAL jobs${JOBS}_${part})
+    message(FATAL_ERROR "--shards ${SHARDS} gives a different ${part} with "
+      "--jobs 1 and --jobs ${JOBS}")
+  endif()
+endforeach()
+
+# Each function is defined in exactly one shard, with the expected linkage
+set(shard_of "")
+foreach(name ${functions})
+  set(found -1)
+  foreach(shard RANGE ${last_shard})
+    find_definition("${jobs1_${shard}}" ${name} position linkage)
+    if(NOT position EQUAL -1)
+      if(NOT found EQUAL -1)
+        message(FATAL_ERROR "${name} is defined in several shards")
+      endif()
+      set(found ${shard})
+      set(linkage_${name} "${linkage}")
+    endif()
+  endforeach()
+  if(found EQUAL -1)
+    message(FATAL_ERROR "${name} is not defined in any shard")
+  endif()
+  set(shard_${name} ${found})
+endforeach()
+foreach(shard RANGE ${last_shard})
+  check_order("${jobs1_${shard}}" "shard ${shard}")
+endforeach()
+foreach(name ${functions})
+  list(FIND public ${name} public_index)
+  if(public_index EQUAL -1)
+    set(internal TRUE)
+  else()
+    set(internal FALSE)
+  endif()
+  foreach(call ${calls})
+    string(REPLACE ":" ";" pair ${call})
+    list(GET pair 0 caller)
+    list(GET pair 1 callee)
+    if(callee STREQUAL name AND
+      NOT shard_${caller} EQUAL shard_${name})
+      set(internal FALSE)
+    endif()
+  endforeach()
+  string(REGEX MATCH "\nint ${name}\\(" declared "${jobs1_header}")
+  if(internal)
+    if(linkage_${name} STREQUAL "" OR NOT declared STREQUAL "")
+      message(FATAL_ERROR "${name} is only called from shard "
+        "${shard_${name}}, but is not internal to it:\n${jobs1_header}")
+    endif()
+  elseif(NOT linkage_${name} STREQUAL "" OR declared STREQUAL "")
+    message(FATAL_ERROR "${name} is called from other shards, but is "
+      "not declared in the header:\n${jobs1_header}")
+  endif()
+endforeach()
+
+# Editing f1 only changes the shard defining it
+run_veil(stdout --shards ${SHARDS} --output-dir ${root}/edited/out
+  ${root}/edited/main.v)
+read_shards(${root}/edited/out edited)
+if(NOT edited_header STREQUAL jobs1_header)
+  message(FATAL_ERROR "editing f1 changed the header")
+endif()
+foreach(shard RANGE ${last_shard})
+  set(before "${jobs1_${shard}}")
+  set(after "${edited_${shard}}")
+  if(shard EQUAL shard_f1 AND before STREQUAL after)
+    message(FATAL_ERROR "editing f1 did not change its shard ${shard}")
+  elseif(NOT shard EQUAL shard_f1 AND NOT before STREQUAL after)
+    message(FATAL_ERROR "editing f1 changed shard ${shard}, but f1 is in "
+      "shard ${shard_f1}")
+  endif()
+endforeach()
+
+# The program returns the same with one and with several source files
+foreach(shards 1 ${SHARDS})
+  run_veil(stdout --shards ${shards} --output-dir ${root}/build${shards}
+    --build ${root}/main.v)
+  execute_process(COMMAND ${root}/build${shards}/default
+    RESULT_VARIABLE exit_${shards})
+endforeach()
+if(NOT exit_1 STREQUAL exit_${SHARDS})
+  message(FATAL_ERROR "the program returned ${exit_1} from one source file, "
+    "but ${exit_${SHARDS}} from ${SHARDS}")
+endif()
@@ -0,0 +1,164 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+/*
+  Identifies the pool and queue owned by the current thread, if it is a worker,
+  so that tasks submitted by workers are queued locally.
+*/
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_queue = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t thread_count):
+  next_queue_{0},
+  queued_{0},
+  completed_{0},
+  waiting_{0},
+  stopping_{false}
+{
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this, i] { run_worker(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{sleep_mutex_};
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  std::size_t index = current_pool == this
+    ? current_queue
+    : next_queue_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock{queues_[index]->mutex};
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  bool waiting;
+  {
+    std::lock_guard<std::mutex> lock{sleep_mutex_};
+    ++queued_;
+    waiting = waiting_ > 0;
+  }
+  wake_.notify_one();
+  // Waiting threads help with the new task too
+  if (waiting) finished_.notify_all();
+}
+
+void ThreadPool::wait_until(const std::function<bool()>& done) {
+  std::size_t index = current_pool == this ? current_queue : 0;
+  while (true) {
+    /*
+      The count is taken before checking done, so that the task making done
+      true completes after it and wakes this thread
+    */
+    std::size_t completed;
+    {
+      std::lock_guard<std::mutex> lock{sleep_mutex_};
+      completed = completed_;
+    }
+    if (done()) return;
+    if (run_one(index)) continue;
+    std::unique_lock<std::mutex> lock{sleep_mutex_};
+    ++waiting_;
+    finished_.wait(lock,
+      [&] { return completed_ != completed || queued_ > 0; });
+    --waiting_;
+  }
+}
+
+void ThreadPool::parallel_for(
+  std::size_t count, const std::function<void(std::size_t)>& body)
+{
+  std::atomic<std::size_t> remaining{count};
+  std::exception_ptr exception;
+  std::mutex exception_mutex;
+  for (std::size_t i = 0; i < count; ++i) {
+    submit([&, i] {
+      try {
+        body(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{exception_mutex};
+        if (!exception) exception = std::current_exception();
+      }
+      --remaining;
+    });
+  }
+  wait_until([&] { return remaining == 0; });
+  if (exception) std::rethrow_exception(exception);
+}
+
+// Main loop of a worker thread, sleeping whenever no tasks are queued
+void ThreadPool::run_worker(std::size_t index) {
+  current_pool = this;
+  current_queue = index;
+  while (true) {
+    if (run_one(index)) continue;
+    std::unique_lock<std::mutex> lock{sleep_mutex_};
+    wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+    if (stopping_ && queued_ == 0) return;
+  }
+}
+
+/*
+  Runs one task, preferring the back of the queue at index and otherwise
+  stealing from the front of another queue. Returns false if no task was found.
+*/
+bool ThreadPool::run_one(std::size_t index) {
+  std::function<void()> task;
+  for (std::size_t i = 0; i < queues_.size() && !task; ++i) {
+    Queue& queue = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.tasks.empty()) continue;
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+  if (!task) return false;
+  --queued_;
+  task();
+  bool waiting;
+  {
+    std::lock_guard<std::mutex> lock{sleep_mutex_};
+    ++completed_;
+    waiting = waiting_ > 0;
+  }
+  if (waiting) finished_.notify_all();
+  return true;
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  A work-stealing thread pool shared by the compiler phases that run in
+  parallel. Every worker owns a queue of tasks. Tasks submitted from a worker go
+  to the back of its own queue, and the worker takes tasks from the back of its
+  own queue, so related work stays on one core. A worker whose queue is empty
+  steals from the front of the other workers' queues.
+
+  Threads that wait for results (see wait_until and parallel_for) run queued
+  tasks while they wait, so tasks may wait for the tasks they submitted without
+  deadlocking the pool. The queued tasks run on the waiting thread's own stack,
+  so a task must never wait for a result produced by an unrelated task, which
+  may be suspended beneath it on the same stack.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs tasks on a fixed set of worker threads
+class ThreadPool {
+public:
+  /*
+    Starts thread_count worker threads. If thread_count is 0, one worker is
+    started per hardware thread.
+  */
+  explicit ThreadPool(std::size_t thread_count = 0);
+
+  // Finishes all queued tasks, then stops the worker threads
+  ~ThreadPool();
+
+  // Not copyable or assignable
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Number of worker threads
+  std::size_t thread_count() const { return threads_.size(); }
+
+  // Queues a task to be run by one of the workers
+  void submit(std::function<void()> task);
+
+  /*
+    Runs queued tasks on the calling thread until done returns true, sleeping
+    while no task is queued until another task completes. The done predicate
+    must become true as a result of tasks completing.
+  */
+  void wait_until(const std::function<bool()>& done);
+
+  /*
+    Runs body(i) for every i in [0, count), in parallel, returning once all of
+    them have completed. If any call throws, the first exception is rethrown
+    after the others have completed.
+  */
+  void parallel_for(
+    std::size_t count, const std::function<void(std::size_t)>& body);
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void run_worker(std::size_t index);
+  bool run_one(std::size_t index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> next_queue_;
+  // Number of tasks waiting in the queues, not including running tasks
+  std::atomic<std::size_t> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  // Notified when a task completes or is queued while threads wait for results
+  std::condition_variable finished_;
+  // Number of tasks completed, guarded by sleep_mutex_
+  std::size_t completed_;
+  // Number of threads sleeping in wait_until, guarded by sleep_mutex_
+  std::size_t waiting_;
+  bool stopping_;
+};
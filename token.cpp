@@ -21,39 +21,96 @@ std::ostream& operator<<(std::ostream& os, const TokenType& token_type) {
     case TokenType::arrow:
       os << "arrow";
       break;
+    case TokenType::at:
+      os << "at";
+      break;
+    case TokenType::class_keyword:
+      os << "class_keyword";
+      break;
     case TokenType::comma:
       os << "comma";
       break;
     case TokenType::divide:
       os << "divide";
       break;
+    case TokenType::divide_equal:
+      os << "divide_equal";
+      break;
+    case TokenType::dot:
+      os << "dot";
+      break;
     case TokenType::end:
       os << "end";
       break;
+    case TokenType::equal:
+      os << "equal";
+      break;
+    case TokenType::equal_equal:
+      os << "equal_equal";
+      break;
     case TokenType::func_keyword:
       os << "func_keyword";
       break;
+    case TokenType::greater:
+      os << "greater";
+      break;
+    case TokenType::greater_equal:
+      os << "greater_equal";
+      break;
     case TokenType::identifier:
       os << "identifier";
       break;
+    case TokenType::import_keyword:
+      os << "import_keyword";
+      break;
+    case TokenType::integer:
+      os << "integer";
+      break;
     case TokenType::left_curly:
       os << "left_curly";
       break;
     case TokenType::left_paren:
       os << "left_paren";
       break;
+    case TokenType::less:
+      os << "less";
+      break;
+    case TokenType::less_equal:
+      os << "less_equal";
+      break;
     case TokenType::minus:
       os << "minus";
       break;
+    case TokenType::minus_equal:
+      os << "minus_equal";
+      break;
     case TokenType::modulo:
       os << "modulo";
       break;
+    case TokenType::modulo_equal:
+      os << "modulo_equal";
+      break;
     case TokenType::multiply:
       os << "multiply";
       break;
+    case TokenType::multiply_equal:
+      os << "multiply_equal";
+      break;
+    case TokenType::not_equal:
+      os << "not_equal";
+      break;
+    case TokenType::package_keyword:
+      os << "package_keyword";
+      break;
     case TokenType::plus:
       os << "plus";
       break;
+    case TokenType::plus_equal:
+      os << "plus_equal";
+      break;
+    case TokenType::pub_keyword:
+      os << "pub_keyword";
+      break;
     case TokenType::return_keyword:
       os << "return_keyword";
       break;
@@ -66,6 +123,9 @@ std::ostream& operator<<(std::ostream& os, const TokenType& token_type) {
     case TokenType::semicolon:
       os << "semicolon";
       break;
+    case TokenType::unknown:
+      os << "unknown";
+      break;
     default:
       os << "unknown";
       break;
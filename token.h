@@ -21,21 +21,42 @@
 
 enum class TokenType {
   arrow,
+  at,
+  class_keyword,
   comma,
   divide,
+  divide_equal,
+  dot,
   end,
+  equal,
+  equal_equal,
   func_keyword,
+  greater,
+  greater_equal,
   identifier,
+  import_keyword,
+  integer,
   left_curly,
   left_paren,
+  less,
+  less_equal,
   minus,
+  minus_equal,
   modulo,
+  modulo_equal,
   multiply,
+  multiply_equal,
+  not_equal,
+  package_keyword,
   plus,
+  plus_equal,
+  pub_keyword,
   return_keyword,
   right_curly,
   right_paren,
   semicolon,
+  // A character that does not begin any valid token
+  unknown,
 };
 
 struct Token {
@@ -0,0 +1,71 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "translation_cache.h"
+#include <cstdio>
+#include <filesystem>
+#include <utility>
+#include "files.h"
+#include "hasher.h"
+
+namespace {
+
+/*
+  Version of the C code produced by the translator. Must be changed whenever
+  the translation of a function changes, so that entries written by older
+  compilers are not used.
+*/
+constexpr const char* translator_version = "veil-translator-2";
+
+}  // namespace
+
+TranslationCache::TranslationCache(std::string directory):
+  directory_{std::move(directory)},
+  hits_{0},
+  misses_{0}
+{
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+}
+
+std::optional<std::string> TranslationCache::find(const Function& function) {
+  std::optional<std::string> code = read_file(path(function));
+  if (code) {
+    ++hits_;
+  } else {
+    ++misses_;
+  }
+  return code;
+}
+
+void TranslationCache::store(
+  const Function& function, const std::string& code)
+{
+  write_file_if_changed(path(function), code);
+}
+
+// Names the entry after the hash of the function and the translator version
+std::string TranslationCache::path(const Function& function) const {
+  std::uint64_t function_hash = hash(function);
+  std::string version{translator_version};
+  std::uint64_t key = hash_bytes(&function_hash, sizeof(function_hash),
+    hash_bytes(version.data(), version.size()));
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx",
+    static_cast<unsigned long long>(key));
+  return (std::filesystem::path{directory_} / (std::string{name} + ".c"))
+    .string();
+}
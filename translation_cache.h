@@ -0,0 +1,67 @@
+/*
+  Copyright 2024 Google LLC
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  An on-disk cache of the C code of functions, so that functions that did not
+  change since a previous compilation are not translated again. Each function
+  is keyed by its structural hash (see hasher.h), which covers everything that
+  the translation of the function depends on, combined with a version of the
+  translator. Each entry is a file in the cache directory named by its key.
+
+  The cache may be used from multiple threads at once, and by multiple
+  compilations at once, since entries are written by atomically replacing the
+  file.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include "graph.h"
+
+// Caches the C code of functions in a directory
+class TranslationCache {
+public:
+  // The directory is created if it does not exist
+  explicit TranslationCache(std::string directory);
+
+  /*
+    Returns the cached C code of the function, if any, counting a hit or a
+    miss. The hash of the function is computed if not already cached, so the
+    function must not be modified concurrently.
+  */
+  std::optional<std::string> find(const Function& function);
+
+  /*
+    Stores the C code of the function. Failing to write the entry is not an
+    error, since the code is then translated again next time.
+  */
+  void store(const Function& function, const std::string& code);
+
+  // Number of functions found in the cache, and not found
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+private:
+  std::string path(const Function& function) const;
+
+  std::string directory_;
+  std::atomic<std::size_t> hits_;
+  std::atomic<std::size_t> misses_;
+};
@@ -15,84 +15,585 @@
 */
 
 #include "translator.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hasher.h"
 
-std::string translate(std::shared_ptr<Package> package) {
-  std::string code;
-  for (auto function : package->function_entities()) {
-    code += translate(function);
-  }
-  return code;
-}
-
-std::string translate(std::shared_ptr<Function> function) {
-  std::string code;
-  if (function->return_type() == ReturnType::none) {
-    code += "void ";
-  } else if (function->return_type() == ReturnType::value) {
-    code += function->return_class()->name() + " ";
-  }
-  code += function->name() + "(";
-
-  std::string params{};
-  for (
-    auto it = function->object_entities().cbegin();
-    it != function->object_entities().cend();
-    ++it
-  ) {
-    auto object = *it;
-    params += object->cls()->name() + " " + object->name();
-    if (it != function->object_entities().cend() - 1) {
-      params += ", ";
+namespace {
+
+// Functions with internal linkage and at most this many statements are inline
+constexpr std::size_t inline_statement_limit = 3;
+
+const char* translate(OperatorType operator_type) {
+  switch (operator_type) {
+    case OperatorType::assign:
+      return "=";
+    case OperatorType::divide:
+      return "/";
+    case OperatorType::divide_assign:
+      return "/=";
+    case OperatorType::equal:
+      return "==";
+    case OperatorType::greater:
+      return ">";
+    case OperatorType::greater_equal:
+      return ">=";
+    case OperatorType::less:
+      return "<";
+    case OperatorType::less_equal:
+      return "<=";
+    case OperatorType::minus:
+      return "-";
+    case OperatorType::minus_assign:
+      return "-=";
+    case OperatorType::modulo:
+      return "%";
+    case OperatorType::modulo_assign:
+      return "%=";
+    case OperatorType::multiply:
+      return "*";
+    case OperatorType::multiply_assign:
+      return "*=";
+    case OperatorType::not_equal:
+      return "!=";
+    case OperatorType::plus:
+      return "+";
+    case OperatorType::plus_assign:
+      return "+=";
+    default:
+      return "?";
+  }
+}
+
+/*
+  Appends the C name of the class or function to code. Packages may use the
+  same names for their own entities, so the names of the entities of named
+  packages are prefixed with the package name, as in pkg__helper. The main
+  package, when it has no package declaration, keeps its names, as do the
+  built in int and the entry point main.
+*/
+void append_name(const Entity& entity, OutputBuffer& code) {
+  const std::string& name = entity.name();
+  std::shared_ptr<Entity> package = entity.parent();
+  if (package && package->name() != "default" && name != "int" &&
+    name != "main")
+  {
+    code << package->name() << "__";
+  }
+  code << name;
+}
+
+/*
+  Appends the C code for an integer constant to code. Negative constants are
+  parenthesized, so that they cannot merge with a preceding minus sign, and the
+  smallest int is written as an expression, since its magnitude is not an int.
+*/
+void append_integer(std::int64_t value, OutputBuffer& code) {
+  if (value >= 0) {
+    code << value;
+  } else if (value == std::numeric_limits<std::int32_t>::min()) {
+    code << "(-2147483647-1)";
+  } else {
+    code << "(-" << -value << ')';
+  }
+}
+
+/*
+  Appends the C code for the expression to code. Expressions may be nested
+  arbitrarily deep, so instead of recursing, the sub-expressions of each
+  operator or call expression being translated are tracked on an explicit
+  stack.
+*/
+void append_expression(const Expression& root, OutputBuffer& code) {
+  struct Frame {
+    const std::vector<std::shared_ptr<Expression>>* expressions;
+    // Code between consecutive sub-expressions
+    const char* separator;
+    // Index of the next sub-expression to translate
+    std::size_t next;
+  };
+  std::vector<Frame> stack;
+  const Expression* expression = &root;
+  while (true) {
+    if (auto operator_expression =
+      dynamic_cast<const OperatorExpression*>(expression))
+    {
+      code << '(';
+      stack.push_back(Frame{&operator_expression->expression_entities(),
+        translate(operator_expression->operator_type()), 0});
+    } else if (auto call_expression =
+      dynamic_cast<const CallExpression*>(expression))
+    {
+      append_name(*call_expression->function(), code);
+      code << '(';
+      stack.push_back(
+        Frame{&call_expression->expression_entities(), ", ", 0});
+    } else if (auto object_expression =
+      dynamic_cast<const ObjectExpression*>(expression))
+    {
+      code << object_expression->object()->name();
+    } else if (auto integer_expression =
+      dynamic_cast<const IntegerExpression*>(expression))
+    {
+      append_integer(integer_expression->value(), code);
     }
+
+    // Find the next sub-expression, closing finished operator expressions
+    expression = nullptr;
+    while (!expression && !stack.empty()) {
+      Frame& frame = stack.back();
+      const auto& expressions = *frame.expressions;
+      if (frame.next == expressions.size()) {
+        code << ')';
+        stack.pop_back();
+      } else {
+        if (frame.next > 0) code << frame.separator;
+        expression = expressions[frame.next++].get();
+      }
+    }
+    if (!expression) return;
+  }
+}
+
+/*
+  Appends the C definition of the class to code. Built in classes are already
+  defined by C. Classes cannot have members yet, and C does not allow empty
+  structs, so each class is given a placeholder member.
+*/
+void append_class(const Class& cls, OutputBuffer& code) {
+  if (cls.name() == "int") return;
+  code << "typedef struct ";
+  append_name(cls, code);
+  code << " { char unused; } ";
+  append_name(cls, code);
+  code << ";\n";
+}
+
+// Appends the C declarator of the function, without the body, to code
+void append_signature(const Function& function, OutputBuffer& code) {
+  if (function.return_type() == ReturnType::none) {
+    code << "void ";
+  } else if (function.return_type() == ReturnType::value) {
+    append_name(*function.return_class(), code);
+    code << ' ';
+  }
+  append_name(function, code);
+  code << '(';
+  const auto& objects = function.object_entities();
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    if (i > 0) code << ", ";
+    append_name(*objects[i]->cls(), code);
+    code << ' ' << objects[i]->name();
   }
-  code += params + ") {\n";
+  code << ')';
+}
+
+/*
+  Whether the function may be called from other C files, being public or the
+  entry point of the program. Other functions are only called from within
+  their package, so they are given internal linkage unless the package is
+  split over several C files.
+*/
+bool is_exported(const Function& function) {
+  return function.is_public() || function.name() == "main";
+}
 
-  for (auto statement : function->statement_entities()) {
-    code += "  ";
+// Appends the C prototype of the function to code
+void append_prototype(
+  const Function& function, bool internal, OutputBuffer& code)
+{
+  if (internal) code << "static ";
+  append_signature(function, code);
+  code << ";\n";
+}
+
+// Appends the C code for the function definition to code
+void append_function(const Function& function, OutputBuffer& code) {
+  append_signature(function, code);
+  code << " {\n";
+
+  for (const auto& statement : function.statement_entities()) {
+    code << "  ";
     if (auto return_statement =
-      std::dynamic_pointer_cast<ReturnStatement>(statement))
+      dynamic_cast<const ReturnStatement*>(statement.get()))
+    {
+      code << "return ";
+      append_expression(*return_statement->expression(), code);
+    } else if (auto expression =
+      dynamic_cast<const Expression*>(statement.get()))
     {
-      code += "return " + translate(return_statement->expression());
+      append_expression(*expression, code);
     }
-    code += ";\n";
+    code << ";\n";
   }
-  code += "}\n";
-  return code;
+  code << "}\n";
 }
 
-std::string translate(OperatorType operator_type) {
-  switch (operator_type) {
-    case OperatorType::plus:
-      return "+";
-    default:
-      return "?";
+/*
+  Appends the C code for the function definition to code, taking it from the
+  cache if present, or storing it in the cache otherwise
+*/
+void append_cached_function(
+  const Function& function, OutputBuffer& code, TranslationCache* cache)
+{
+  if (!cache) {
+    append_function(function, code);
+  } else if (std::optional<std::string> cached = cache->find(function)) {
+    code << *cached;
+  } else {
+    std::size_t begin = code.size();
+    append_function(function, code);
+    cache->store(function, code.str(begin));
   }
 }
 
-std::string translate(std::shared_ptr<Expression> expression)
+/*
+  Appends the C code for the function definition to code, like
+  append_cached_function, with internal linkage if internal. Small functions
+  with internal linkage are also declared inline.
+*/
+void append_definition(const Function& function, bool internal,
+  OutputBuffer& code, TranslationCache* cache)
 {
-  std::string code;
-  if (auto operator_expression =
-    std::dynamic_pointer_cast<OperatorExpression>(expression))
-  {
-    code += "(";
-    for (
-      auto it = operator_expression->expression_entities().cbegin();
-      it != operator_expression->expression_entities().cend();
-      ++it
-    ) {
-      auto expression = *it;
-      code += translate(expression);
-      if (it != operator_expression->expression_entities().cend() - 1) {
-        code += translate(operator_expression->operator_type());
+  if (internal) {
+    code << (function.statement_entities().size() <= inline_statement_limit ?
+      "static inline " : "static ");
+  }
+  append_cached_function(function, code, cache);
+}
+
+// Functions called by each of a list of functions, as indices into the list
+using Calls = std::vector<std::vector<std::size_t>>;
+
+/*
+  Finds the calls between the functions, each callee once per caller, in order
+  of first call. Calls to functions outside the list are ignored.
+*/
+Calls find_calls(const std::vector<const Function*>& functions) {
+  std::unordered_map<const Function*, std::size_t> indices;
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    indices.emplace(functions[i], i);
+  }
+  Calls calls(functions.size());
+  std::vector<const Expression*> stack;
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    for (const auto& statement : functions[i]->statement_entities()) {
+      if (auto return_statement =
+        dynamic_cast<const ReturnStatement*>(statement.get()))
+      {
+        stack.push_back(return_statement->expression().get());
+      } else if (auto expression =
+        dynamic_cast<const Expression*>(statement.get()))
+      {
+        stack.push_back(expression);
+      }
+    }
+    // Expressions may be nested arbitrarily deep, so walk them iteratively
+    while (!stack.empty()) {
+      const Expression* expression = stack.back();
+      stack.pop_back();
+      if (auto operator_expression =
+        dynamic_cast<const OperatorExpression*>(expression))
+      {
+        for (const auto& operand : operator_expression->expression_entities()) {
+          stack.push_back(operand.get());
+        }
+      } else if (auto call_expression =
+        dynamic_cast<const CallExpression*>(expression))
+      {
+        auto callee = indices.find(call_expression->function().get());
+        if (callee != indices.end() &&
+          std::find(calls[i].begin(), calls[i].end(), callee->second) ==
+            calls[i].end())
+        {
+          calls[i].push_back(callee->second);
+        }
+        for (const auto& argument : call_expression->expression_entities()) {
+          stack.push_back(argument.get());
+        }
       }
     }
-    code += ")";
   }
-  else if (auto object_expression =
-    std::dynamic_pointer_cast<ObjectExpression>(expression))
-  {
-    code += object_expression->object()->name();
+  return calls;
+}
+
+/*
+  Returns the functions assigned to the given shard, ordered so that every
+  function comes after the functions it calls in the shard, except where
+  functions call each other recursively. C compilers that inline while reading
+  a file can then inline each call into its caller, and unused functions with
+  internal linkage are next to each other for the linker to discard. Functions
+  are otherwise kept in declaration order, and only calls within the shard
+  affect the order, so editing a function in one shard does not reorder
+  another.
+*/
+std::vector<std::size_t> order_by_calls(const Calls& calls,
+  const std::vector<std::size_t>& shards, std::size_t shard)
+{
+  // Depth-first search without recursion, outputting callees first
+  struct Frame {
+    std::size_t function;
+    // Index of the next callee to visit
+    std::size_t next;
+  };
+  std::vector<std::size_t> order;
+  std::vector<bool> visited(calls.size(), false);
+  std::vector<Frame> stack;
+  for (std::size_t root = 0; root < calls.size(); ++root) {
+    if (shards[root] != shard || visited[root]) continue;
+    visited[root] = true;
+    stack.push_back(Frame{root, 0});
+    while (!stack.empty()) {
+      Frame& frame = stack.back();
+      const std::vector<std::size_t>& callees = calls[frame.function];
+      if (frame.next == callees.size()) {
+        order.push_back(frame.function);
+        stack.pop_back();
+        continue;
+      }
+      std::size_t callee = callees[frame.next++];
+      if (shards[callee] == shard && !visited[callee]) {
+        visited[callee] = true;
+        stack.push_back(Frame{callee, 0});
+      }
+    }
+  }
+  return order;
+}
+
+// Functions of the package, in declaration order
+std::vector<const Function*> package_functions(const Package& package) {
+  std::vector<const Function*> functions;
+  for (const auto& function : package.function_entities()) {
+    functions.push_back(function.get());
+  }
+  return functions;
+}
+
+/*
+  Appends the C code for the classes and the prototypes of the functions of
+  the package to code
+*/
+void append_declarations(const Package& package, OutputBuffer& code) {
+  for (const auto& cls : package.class_entities()) {
+    append_class(*cls, code);
+  }
+  for (const auto& function : package.function_entities()) {
+    append_prototype(*function, !is_exported(*function), code);
+  }
+}
+
+/*
+  Estimated cost of compiling the C code of the function, used to balance
+  shards
+*/
+std::size_t compile_cost(const Function& function) {
+  return 1 + function.statement_entities().size();
+}
+
+/*
+  Assigns each function to one of shard_count shards, returning the shard of
+  each function. Each function prefers the shard given by the hash of its name,
+  so that its shard does not depend on the other functions, and moves to the
+  following shards only when the preferred one is already full. Shards may
+  exceed the average cost by a quarter, so most functions stay in their
+  preferred shard, and editing a function rarely moves any other function.
+  Functions are placed from the most to the least costly, breaking ties by
+  name, so that the large functions that are hardest to balance go first.
+*/
+std::vector<std::size_t> assign_shards(
+  const std::vector<const Function*>& functions, std::size_t shard_count)
+{
+  std::vector<std::size_t> costs(functions.size());
+  std::size_t total_cost = 0;
+  std::size_t max_cost = 0;
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    costs[i] = compile_cost(*functions[i]);
+    total_cost += costs[i];
+    max_cost = std::max(max_cost, costs[i]);
+  }
+  std::size_t capacity = std::max(max_cost,
+    (total_cost + total_cost / 4 + shard_count - 1) / shard_count);
+
+  std::vector<std::size_t> order(functions.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    if (costs[a] != costs[b]) return costs[a] > costs[b];
+    return functions[a]->name() < functions[b]->name();
+  });
+
+  std::vector<std::size_t> loads(shard_count, 0);
+  std::vector<std::size_t> shards(functions.size());
+  for (std::size_t i : order) {
+    const std::string& name = functions[i]->name();
+    std::size_t preferred = hash_bytes(name.data(), name.size()) % shard_count;
+    std::size_t shard = preferred;
+    for (std::size_t probe = 0; probe < shard_count; ++probe) {
+      std::size_t candidate = (preferred + probe) % shard_count;
+      if (loads[candidate] + costs[i] <= capacity) {
+        shard = candidate;
+        break;
+      }
+      if (loads[candidate] < loads[shard]) shard = candidate;
+    }
+    loads[shard] += costs[i];
+    shards[i] = shard;
+  }
+  return shards;
+}
+
+}  // namespace
+
+void translate(const std::shared_ptr<Package>& package, OutputBuffer& code) {
+  append_declarations(*package, code);
+  std::vector<const Function*> functions{package_functions(*package)};
+  std::vector<std::size_t> shards(functions.size(), 0);
+  for (std::size_t i : order_by_calls(find_calls(functions), shards, 0)) {
+    append_definition(
+      *functions[i], !is_exported(*functions[i]), code, nullptr);
+  }
+}
+
+void translate(const std::shared_ptr<Package>& package, OutputBuffer& code,
+  ThreadPool& thread_pool, TranslationCache* cache)
+{
+  append_declarations(*package, code);
+  std::vector<const Function*> functions{package_functions(*package)};
+  std::vector<std::size_t> shards(functions.size(), 0);
+  std::vector<std::size_t> order{
+    order_by_calls(find_calls(functions), shards, 0)};
+
+  // A few blocks per worker, to balance functions of different sizes
+  std::size_t block_count =
+    std::min(order.size(), thread_pool.thread_count() * 4);
+  std::vector<OutputBuffer> blocks(block_count);
+  thread_pool.parallel_for(block_count, [&](std::size_t block) {
+    std::size_t end = order.size() * (block + 1) / block_count;
+    for (std::size_t i = order.size() * block / block_count; i < end; ++i) {
+      const Function& function = *functions[order[i]];
+      append_definition(function, !is_exported(function), blocks[block], cache);
+    }
+  });
+  for (const OutputBuffer& block : blocks) {
+    code.append(block);
+  }
+}
+
+ShardedCode translate(const std::vector<std::shared_ptr<Package>>& packages,
+  const std::vector<std::shared_ptr<Package>>& imported,
+  std::size_t shard_count, const std::string& header_name,
+  ThreadPool& thread_pool, TranslationCache* cache)
+{
+  std::vector<const Function*> functions;
+  for (const auto& package : packages) {
+    for (const Function* function : package_functions(*package)) {
+      functions.push_back(function);
+    }
+  }
+  std::vector<std::size_t> shards{assign_shards(functions, shard_count)};
+  Calls calls{find_calls(functions)};
+
+  /*
+    Functions that are only called from their own shard are given internal
+    linkage, and declared in their shard rather than in the header
+  */
+  std::vector<bool> internal(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    internal[i] = !is_exported(*functions[i]);
   }
-  return code;
-}
\ No newline at end of file
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    for (std::size_t callee : calls[i]) {
+      if (shards[callee] != shards[i]) internal[callee] = false;
+    }
+  }
+
+  ShardedCode sharded;
+  OutputBuffer header;
+  header << "#ifndef VEIL_GENERATED_HEADER\n#define VEIL_GENERATED_HEADER\n";
+  for (const auto* list : {&imported, &packages}) {
+    for (const auto& package : *list) {
+      for (const auto& cls : package->class_entities()) {
+        append_class(*cls, header);
+      }
+    }
+  }
+  for (const auto& package : imported) {
+    for (const auto& function : package->function_entities()) {
+      append_prototype(*function, false, header);
+    }
+  }
+  for (std::size_t i = 0; i < functions.size(); ++i) {
+    if (!internal[i]) append_prototype(*functions[i], false, header);
+  }
+  header << "#endif\n";
+  sharded.header = header.str();
+
+  sharded.shards.resize(shard_count);
+  thread_pool.parallel_for(shard_count, [&](std::size_t shard) {
+    OutputBuffer code;
+    code << "#include \"" << header_name << "\"\n";
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+      if (shards[i] == shard && internal[i]) {
+        append_prototype(*functions[i], true, code);
+      }
+    }
+    for (std::size_t i : order_by_calls(calls, shards, shard)) {
+      append_definition(*functions[i], internal[i], code, cache);
+    }
+    sharded.shards[shard] = code.str();
+  });
+  return sharded;
+}
+
+void translate(const std::shared_ptr<Class>& cls, OutputBuffer& code) {
+  append_class(*cls, code);
+}
+
+void translate(const std::shared_ptr<Function>& function, OutputBuffer& code,
+  TranslationCache* cache)
+{
+  append_definition(*function, !is_exported(*function), code, cache);
+}
+
+void translate_declarations(
+  const std::shared_ptr<Package>& package, OutputBuffer& code)
+{
+  append_declarations(*package, code);
+}
+
+void translate(
+  const std::shared_ptr<Expression>& expression, OutputBuffer& code)
+{
+  append_expression(*expression, code);
+}
+
+std::string translate(const std::shared_ptr<Package>& package) {
+  OutputBuffer code;
+  translate(package, code);
+  return code.str();
+}
+
+std::string translate(const std::shared_ptr<Class>& cls) {
+  OutputBuffer code;
+  translate(cls, code);
+  return code.str();
+}
+
+std::string translate(const std::shared_ptr<Function>& function) {
+  OutputBuffer code;
+  translate(function, code);
+  return code.str();
+}
+
+std::string translate(const std::shared_ptr<Expression>& expression) {
+  OutputBuffer code;
+  translate(expression, code);
+  return code.str();
+}
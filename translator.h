@@ -23,14 +23,82 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include "graph.h"
+#include "output_buffer.h"
+#include "thread_pool.h"
+#include "translation_cache.h"
 
 /*
-  These functions convert the given graph entity into valid C code. Child
-  entities will be recursively visited in order to output proper program logic
-  (a function's parameters and statements, an expression's sub-expressions,
-  etc.).
+  These functions convert the given graph entity into valid C code, appending
+  it to code. Child entities will be visited in order to output proper program
+  logic (a function's parameters and statements, an expression's
+  sub-expressions, etc.). Expressions are visited without recursion, so
+  arbitrarily deep expressions can be translated.
+
+  Packages are translated into their class definitions, prototypes of all of
+  their functions, so that functions may call each other in any order, and
+  then the function definitions, with callees before their callers. Functions
+  that are not public (other than main) are given internal linkage, so that
+  the C compiler may inline them and discard them when unused, and small ones
+  are also declared inline.
+
+  If a cache is given, the code of functions is taken from the cache when
+  present, and stored in it otherwise.
+*/
+void translate(const std::shared_ptr<Package>& package, OutputBuffer& code);
+void translate(const std::shared_ptr<Class>& cls, OutputBuffer& code);
+void translate(const std::shared_ptr<Function>& function, OutputBuffer& code,
+  TranslationCache* cache = nullptr);
+void translate(
+  const std::shared_ptr<Expression>& expression, OutputBuffer& code);
+
+/*
+  Appends the class definitions and function prototypes of the package to
+  code, without the function definitions, which may then be translated one at
+  a time
+*/
+void translate_declarations(
+  const std::shared_ptr<Package>& package, OutputBuffer& code);
+
+/*
+  Translates the package like the serial overload, with the same result, but
+  translates the functions on the thread pool. The functions are split into
+  contiguous blocks, each translated into its own buffer, and the buffers are
+  appended to code in order.
 */
-std::string translate(std::shared_ptr<Package> package);
-std::string translate(std::shared_ptr<Function> function);
-std::string translate(std::shared_ptr<Expression> expression);
\ No newline at end of file
+void translate(const std::shared_ptr<Package>& package, OutputBuffer& code,
+  ThreadPool& thread_pool, TranslationCache* cache = nullptr);
+
+// C code of packages split into separately compiled source files
+struct ShardedCode {
+  // Type definitions and function prototypes, included by every shard
+  std::string header;
+  // Source files defining the functions
+  std::vector<std::string> shards;
+};
+
+/*
+  Translates the packages into a header and shard_count source files, so that
+  the source files can be compiled in parallel. Each source file includes the
+  header by header_name. Functions are spread over the shards to balance their
+  statement counts, and each function is placed independently of the order of
+  the others, so that editing a function usually only changes its own shard
+  (see assign_shards). Functions that are not public and are only called from
+  their own shard have internal linkage, and are declared in their shard
+  rather than the header. The shards are translated on the thread pool.
+
+  The imported packages are compiled separately, such as those loaded from
+  their interfaces, so only their classes and function prototypes are written,
+  to the header, for the packages that use them.
+*/
+ShardedCode translate(const std::vector<std::shared_ptr<Package>>& packages,
+  const std::vector<std::shared_ptr<Package>>& imported,
+  std::size_t shard_count, const std::string& header_name,
+  ThreadPool& thread_pool, TranslationCache* cache = nullptr);
+
+// The same, returning the code as a string
+std::string translate(const std::shared_ptr<Package>& package);
+std::string translate(const std::shared_ptr<Class>& cls);
+std::string translate(const std::shared_ptr<Function>& function);
+std::string translate(const std::shared_ptr<Expression>& expression);
\ No newline at end of file